@@ -1,3 +1,7 @@
 #!/bin/bash
 
-gcc -O3 src/main.c src/map.c src/fifo.c src/gpxParser.c src/tracks.c src/filters.c src/heat.c src/ui.c -o footprints -lSDL2 -lSDL2_image -lSDL2_ttf -lcurl -lm -lxml2
\ No newline at end of file
+gcc -O3 src/main.c src/map.c src/fifo.c src/gpxParser.c src/gpxFastParser.c src/fitParser.c src/archive.c src/fastparse.c src/trackcache.c src/pointarena.c src/tracks.c src/filters.c src/heat.c src/heatgrid.c src/kdtree.c src/watcher.c src/loader.c src/pyramid.c src/batch.c src/perf.c src/trace.c src/memstat.c src/ui.c -o footprints -lSDL2 -lSDL2_image -lSDL2_ttf -lcurl -lm -lxml2 -lz
+
+gcc -O3 src/bench.c src/fastparse.c -o footprints_bench -lm
+
+gcc -O3 src/pipelineBench.c src/corpus.c src/map.c src/fifo.c src/gpxParser.c src/gpxFastParser.c src/fitParser.c src/archive.c src/fastparse.c src/trackcache.c src/pointarena.c src/tracks.c src/filters.c src/heat.c src/heatgrid.c src/kdtree.c src/watcher.c src/loader.c src/pyramid.c src/batch.c src/perf.c src/trace.c src/memstat.c src/ui.c -o footprints_pipeline_bench -lSDL2 -lSDL2_image -lSDL2_ttf -lcurl -lm -lxml2 -lz
@@ -0,0 +1,324 @@
+#include "archive.h"
+
+// Reader for the Garmin export archives: zip members (stored or deflate) and gzip files
+// are decompressed into a caller owned buffer, nothing is written to disk.
+
+static bool archive_has_suffix(const char *name, const char *suffix)
+{
+    size_t length = strlen(name);
+    size_t suffix_length = strlen(suffix);
+    return length > suffix_length && strcasecmp(name + length - suffix_length, suffix) == 0;
+}
+
+bool archive_is_zip(const char *name)
+{
+    return archive_has_suffix(name, ".zip");
+}
+
+bool archive_is_gzip(const char *name)
+{
+    return archive_has_suffix(name, ".gz");
+}
+
+static uint16_t archive_read16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t archive_read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t archive_read64(const unsigned char *p)
+{
+    return (uint64_t)archive_read32(p) | ((uint64_t)archive_read32(p + 4) << 32);
+}
+
+bool byteBuffer_reserve(ByteBuffer *buffer, size_t size)
+{
+    if (size <= buffer->capacity)
+        return true;
+
+    size_t new_capacity = buffer->capacity == 0 ? 1 << 16 : buffer->capacity;
+    while (new_capacity < size)
+        new_capacity *= 2;
+
+    unsigned char *temp = (unsigned char *)realloc(buffer->data, new_capacity);
+    if (temp == NULL)
+    {
+        fprintf(stderr, "Memory reallocation for archive buffer failed.\n");
+        return false;
+    }
+    buffer->data = temp;
+    buffer->capacity = new_capacity;
+    return true;
+}
+
+void byteBuffer_free(ByteBuffer *buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+bool archive_map_zip(const char *path, ZipArchive *archive)
+{
+    archive->data = NULL;
+    archive->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 22)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    archive->data = (const unsigned char *)data;
+    archive->size = st.st_size;
+    return true;
+}
+
+void archive_unmap_zip(ZipArchive *archive)
+{
+    if (archive->data)
+        munmap((void *)archive->data, archive->size);
+    archive->data = NULL;
+    archive->size = 0;
+}
+
+// The end of central directory record sits at the very end, followed by an optional comment
+static const unsigned char *archive_find_end_of_central_dir(const ZipArchive *archive)
+{
+    const unsigned char *p = archive->data + archive->size - 22;
+    const unsigned char *stop = archive->size > 22 + 0xFFFF ? archive->data + archive->size - 22 - 0xFFFF : archive->data;
+    for (; p >= stop; p--)
+    {
+        if (archive_read32(p) == ZIP_END_OF_CENTRAL_DIR_SIG)
+            return p;
+    }
+    return NULL;
+}
+
+bool archive_list_zip(const ZipArchive *archive, bool (*add)(void *context, const char *member, const ArchiveEntry *entry), void *context)
+{
+    const unsigned char *eocd = archive_find_end_of_central_dir(archive);
+    if (eocd == NULL)
+    {
+        fprintf(stderr, "%s is not a zip archive\n", archive->file_name);
+        return false;
+    }
+
+    uint64_t entry_count = archive_read16(eocd + 10);
+    uint64_t dir_offset = archive_read32(eocd + 16);
+
+    // zip64 archives keep the real values in a second record, found through the locator
+    if ((entry_count == 0xFFFF || dir_offset == 0xFFFFFFFF) && eocd - archive->data >= 20 &&
+        archive_read32(eocd - 20) == ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIG)
+    {
+        uint64_t zip64_offset = archive_read64(eocd - 20 + 8);
+        if (zip64_offset + 56 > archive->size || archive_read32(archive->data + zip64_offset) != ZIP64_END_OF_CENTRAL_DIR_SIG)
+            return false;
+        entry_count = archive_read64(archive->data + zip64_offset + 32);
+        dir_offset = archive_read64(archive->data + zip64_offset + 48);
+    }
+
+    const unsigned char *end = archive->data + archive->size;
+    if (dir_offset > archive->size)
+        return false;
+    const unsigned char *p = archive->data + dir_offset;
+
+    char member[512];
+    for (uint64_t i = 0; i < entry_count; i++)
+    {
+        if (end - p < 46 || archive_read32(p) != ZIP_CENTRAL_DIR_FILE_SIG)
+        {
+            fprintf(stderr, "Damaged central directory in %s\n", archive->file_name);
+            return false;
+        }
+
+        ArchiveEntry entry;
+        entry.method = archive_read16(p + 10);
+        entry.crc = archive_read32(p + 16);
+        entry.compressed_size = archive_read32(p + 20);
+        entry.uncompressed_size = archive_read32(p + 24);
+        int name_length = archive_read16(p + 28);
+        int extra_length = archive_read16(p + 30);
+        int comment_length = archive_read16(p + 32);
+        entry.local_header_offset = archive_read32(p + 42);
+
+        const unsigned char *name = p + 46;
+        const unsigned char *extra = name + name_length;
+        const unsigned char *next = extra + extra_length + comment_length;
+        if (next > end)
+            return false;
+
+        // zip64 extended information: only the fields saturated in the header are present, in this order
+        for (const unsigned char *field = extra; field + 4 <= extra + extra_length;)
+        {
+            int id = archive_read16(field);
+            int size = archive_read16(field + 2);
+            const unsigned char *value = field + 4;
+            const unsigned char *value_end = value + size;
+            if (id == 0x0001)
+            {
+                if (entry.uncompressed_size == 0xFFFFFFFF && value + 8 <= value_end)
+                {
+                    entry.uncompressed_size = archive_read64(value);
+                    value += 8;
+                }
+                if (entry.compressed_size == 0xFFFFFFFF && value + 8 <= value_end)
+                {
+                    entry.compressed_size = archive_read64(value);
+                    value += 8;
+                }
+                if (entry.local_header_offset == 0xFFFFFFFF && value + 8 <= value_end)
+                    entry.local_header_offset = archive_read64(value);
+            }
+            field = value_end;
+        }
+
+        // directories end with a slash and have nothing to import
+        if (name_length > 0 && name_length < (int)sizeof(member) && name[name_length - 1] != '/')
+        {
+            memcpy(member, name, name_length);
+            member[name_length] = '\0';
+            if (!add(context, member, &entry))
+                return false;
+        }
+        p = next;
+    }
+    return true;
+}
+
+bool archive_read_zip_entry(const ZipArchive *archive, const ArchiveEntry *entry, ByteBuffer *out)
+{
+    out->size = 0;
+
+    // the local header repeats name and extra field, their lengths may differ from the central directory
+    uint64_t offset = entry->local_header_offset;
+    if (offset + 30 > archive->size || archive_read32(archive->data + offset) != ZIP_LOCAL_FILE_SIG)
+        return false;
+    offset += 30 + archive_read16(archive->data + offset + 26) + archive_read16(archive->data + offset + 28);
+    if (offset + entry->compressed_size > archive->size)
+        return false;
+
+    const unsigned char *compressed = archive->data + offset;
+    if (!byteBuffer_reserve(out, entry->uncompressed_size + 1))
+        return false;
+
+    if (entry->method == 0)
+    {
+        if (entry->compressed_size != entry->uncompressed_size)
+            return false;
+        memcpy(out->data, compressed, entry->uncompressed_size);
+    }
+    else if (entry->method == 8)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return false;
+
+        // zip members are raw deflate streams, inflated in uInt sized steps
+        uint64_t in_left = entry->compressed_size;
+        uint64_t out_left = entry->uncompressed_size;
+        stream.next_in = (Bytef *)compressed;
+        stream.next_out = out->data;
+        int status = Z_OK;
+        while (status == Z_OK)
+        {
+            if (stream.avail_in == 0)
+            {
+                stream.avail_in = in_left > 0x40000000 ? 0x40000000 : (uInt)in_left;
+                in_left -= stream.avail_in;
+            }
+            if (stream.avail_out == 0)
+            {
+                stream.avail_out = out_left > 0x40000000 ? 0x40000000 : (uInt)out_left;
+                out_left -= stream.avail_out;
+            }
+            status = inflate(&stream, Z_NO_FLUSH);
+        }
+        uint64_t produced = stream.total_out;
+        inflateEnd(&stream);
+        if (status != Z_STREAM_END || produced != entry->uncompressed_size)
+            return false;
+    }
+    else
+    {
+        fprintf(stderr, "Unsupported compression method %d in %s\n", entry->method, archive->file_name);
+        return false;
+    }
+
+    // crc32 takes a uInt length as well, zip64 members are checked in the same steps
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (uint64_t offset = 0; offset < entry->uncompressed_size;)
+    {
+        uint64_t left = entry->uncompressed_size - offset;
+        uInt step = left > 0x40000000 ? 0x40000000 : (uInt)left;
+        crc = crc32(crc, out->data + offset, step);
+        offset += step;
+    }
+    if (crc != entry->crc)
+        return false;
+
+    out->size = entry->uncompressed_size;
+    out->data[out->size] = '\0';
+    return true;
+}
+
+bool archive_read_gzip(const char *path, ByteBuffer *out)
+{
+    out->size = 0;
+
+    gzFile file = gzopen(path, "rb");
+    if (file == NULL)
+    {
+        perror("gzopen");
+        return false;
+    }
+    gzbuffer(file, 1 << 17);
+
+    // the uncompressed size is unknown up front, grow the buffer until gzread runs dry
+    while (true)
+    {
+        if (!byteBuffer_reserve(out, out->size + (1 << 16) + 1))
+        {
+            gzclose(file);
+            return false;
+        }
+        size_t space = out->capacity - out->size - 1;
+        int read = gzread(file, out->data + out->size, space > 0x40000000 ? 0x40000000 : (unsigned)space);
+        if (read < 0)
+        {
+            int error;
+            fprintf(stderr, "Failed to decompress %s: %s\n", path, gzerror(file, &error));
+            gzclose(file);
+            return false;
+        }
+        if (read == 0)
+            break;
+        out->size += read;
+    }
+    gzclose(file);
+
+    out->data[out->size] = '\0';
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef archive_h
+#define archive_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "structs.h"
+
+#define ZIP_END_OF_CENTRAL_DIR_SIG 0x06054b50
+#define ZIP64_END_OF_CENTRAL_DIR_SIG 0x06064b50
+#define ZIP64_END_OF_CENTRAL_DIR_LOCATOR_SIG 0x07064b50
+#define ZIP_CENTRAL_DIR_FILE_SIG 0x02014b50
+#define ZIP_LOCAL_FILE_SIG 0x04034b50
+
+bool archive_is_zip(const char *name);
+bool archive_is_gzip(const char *name);
+
+bool archive_map_zip(const char *path, ZipArchive *archive);
+void archive_unmap_zip(ZipArchive *archive);
+
+// Calls add() for every member of the archive, stops and returns false if add() fails
+bool archive_list_zip(const ZipArchive *archive, bool (*add)(void *context, const char *member, const ArchiveEntry *entry), void *context);
+
+bool archive_read_zip_entry(const ZipArchive *archive, const ArchiveEntry *entry, ByteBuffer *out);
+bool archive_read_gzip(const char *path, ByteBuffer *out);
+
+bool byteBuffer_reserve(ByteBuffer *buffer, size_t size);
+void byteBuffer_free(ByteBuffer *buffer);
+
+#endif
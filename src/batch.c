@@ -0,0 +1,220 @@
+#include "batch.h"
+
+// Headless mode: import a folder, calculate the heat and write the results without opening a window.
+// The track cache is not used, every run parses all files again.
+
+static double batch_seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static const char *batch_activity_name(ActivityType type)
+{
+    if (type == Run)
+        return "Run";
+    if (type == Hike)
+        return "Hike";
+    if (type == Cycling)
+        return "Cycling";
+    return "Other";
+}
+
+// Quote a text field, quotes inside are doubled
+static void batch_write_csv_text(FILE *f, const char *text)
+{
+    fputc('"', f);
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '"')
+            fputc('"', f);
+        fputc(*c, f);
+    }
+    fputc('"', f);
+}
+
+static bool batch_write_tracks(const char *path, const GpxCollection *collection)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "track_id,source,type,start_time,end_time,points,heat_samples,distance_km,duration_s,secs_per_km,"
+               "elev_up_m,elev_down_m,high_point_m,low_point_m,max_heat,mean_heat\n");
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        const GpxTrack *track = &collection->tracks[t];
+        int samples;
+        trackPyramid_heat_samples(&collection->pyramid, track, &samples);
+        int max_heat = 0;
+        double heat_sum = 0;
+        for (int i = 0; i < track->total_points; i++)
+        {
+            if (track->heat[i] > max_heat)
+                max_heat = track->heat[i];
+            heat_sum += track->heat[i];
+        }
+
+        fprintf(f, "%d,", track->track_id);
+        batch_write_csv_text(f, track->source_name);
+        fprintf(f, ",%s,%s,%s,%d,%d,%.3f,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f,%d,%.3f\n",
+                batch_activity_name(track->act_type), track->start_time_raw, track->end_time_raw,
+                track->total_points, samples, track->distance, track->duration_secs, track->secs_per_km,
+                track->elev_up, track->elev_down, track->high_point, track->low_point,
+                max_heat, track->total_points > 0 ? heat_sum / track->total_points : 0.0);
+    }
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+// The arena only keeps the projected position, latitude and longitude are projected back from it
+static void batch_expand_point(const PointStream *stream, int track_id, uint16_t heat, GpxPoint *point)
+{
+    point->world_x = stream->world_x;
+    point->world_y = stream->world_y;
+    pixelToLatLon(stream->world_x, stream->world_y, MAX_ZOOM, &point->lat, &point->lon);
+    point->elevation = stream->elevation / POINT_ELEVATION_SCALE;
+    point->partial_distance = stream->partial_distance / POINT_DISTANCE_SCALE;
+    point->heat = heat;
+    point->track_id = track_id;
+}
+
+static bool batch_write_points_csv(const char *path, const GpxCollection *collection)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "track_id,lat,lon,elevation_m,heat\n");
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        const GpxTrack *track = &collection->tracks[t];
+        PointStream stream;
+        pointStream_init(&stream, track);
+        for (int i = 0; pointStream_next(&stream); i++)
+        {
+            GpxPoint pt;
+            batch_expand_point(&stream, track->track_id, track->heat[i], &pt);
+            fprintf(f, "%d,%.7f,%.7f,%.1f,%d\n", pt.track_id, pt.lat, pt.lon, pt.elevation, pt.heat);
+        }
+    }
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+static bool batch_write_points_binary(const char *path, const GpxCollection *collection)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    BatchPointsHeader header = {
+        .magic = BATCH_POINTS_MAGIC,
+        .version = BATCH_POINTS_VERSION,
+        .track_count = (uint32_t)collection->total_tracks,
+        .max_heat = (uint32_t)collection->max_heat,
+        .point_count = 0};
+    for (int t = 0; t < collection->total_tracks; t++)
+        header.point_count += collection->tracks[t].total_points;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (int t = 0; ok && t < collection->total_tracks; t++)
+    {
+        const GpxTrack *track = &collection->tracks[t];
+        PointStream stream;
+        pointStream_init(&stream, track);
+        for (int i = 0; ok && pointStream_next(&stream); i++)
+        {
+            GpxPoint pt;
+            batch_expand_point(&stream, track->track_id, track->heat[i], &pt);
+            BatchPointRecord record = {
+                .lat = pt.lat,
+                .lon = pt.lon,
+                .elevation = pt.elevation,
+                .track_id = pt.track_id,
+                .heat = pt.heat,
+                .padding = 0};
+            ok = fwrite(&record, sizeof(record), 1, f) == 1;
+        }
+    }
+
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+static bool batch_process(GpxCollection *collection, const char *folder_path, const char *output_prefix, bool binary_points)
+{
+    struct timespec start;
+
+    printf("Batch import of %s\n", folder_path);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!gpxParser_parse_all_files(collection, folder_path, NULL, NULL))
+    {
+        fprintf(stderr, "Import of %s failed\n", folder_path);
+        return false;
+    }
+    double parse_seconds = batch_seconds_since(&start);
+
+    reset_filters(&collection->filters);
+    apply_filter_values(collection);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!calculate_heatmap(collection))
+        return false;
+    double heat_seconds = batch_seconds_since(&start);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.tracks.csv", output_prefix);
+    if (!batch_write_tracks(path, collection))
+        return false;
+    printf("Wrote %s\n", path);
+
+    snprintf(path, sizeof(path), "%s.points.%s", output_prefix, binary_points ? "bin" : "csv");
+    if (!(binary_points ? batch_write_points_binary(path, collection) : batch_write_points_csv(path, collection)))
+        return false;
+    printf("Wrote %s\n", path);
+
+    printf("Tracks: %d, points: %zu, maximum heat: %d\n", collection->total_tracks, collection->point_arena.count, collection->max_heat);
+    printf("Import took %.3f seconds, heat %.3f seconds\n", parse_seconds, heat_seconds);
+    memstat_sample_tracks(collection);
+    memstat_print();
+    return true;
+}
+
+// Writes <output_prefix>.tracks.csv and <output_prefix>.points.csv (or .points.bin)
+bool batch_run(const char *folder_path, const char *output_prefix, bool binary_points)
+{
+    GpxCollection collection = {0};
+    gpxParser_init();
+    bool ok = batch_process(&collection, folder_path, output_prefix, binary_points);
+
+    pointArena_free(&collection.point_arena);
+    trackPyramid_free(&collection.pyramid);
+    free(collection.tracks);
+    free(collection.list_order);
+    gpxParser_cleanup();
+    return ok;
+}
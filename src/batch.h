@@ -0,0 +1,42 @@
+#ifndef batch_h
+#define batch_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "structs.h"
+#include "gpxParser.h"
+#include "filters.h"
+#include "heat.h"
+#include "pointarena.h"
+#include "pyramid.h"
+#include "memstat.h"
+
+#define BATCH_POINTS_MAGIC 0x50485046 // "FPHP"
+#define BATCH_POINTS_VERSION 1
+
+// Header of <output>.points.bin, followed by point_count BatchPointRecords
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t track_count;
+    uint32_t max_heat;
+    uint64_t point_count;
+} BatchPointsHeader;
+
+typedef struct
+{
+    double lat;
+    double lon;
+    float elevation;
+    int32_t track_id;
+    int32_t heat;
+    int32_t padding;
+} BatchPointRecord;
+
+bool batch_run(const char *folder_path, const char *output_prefix, bool binary_points);
+
+#endif
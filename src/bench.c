@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fastparse.h"
+
+#define BENCH_DEFAULT_SAMPLES 1000000
+#define BENCH_STRING_SIZE 32
+
+static double bench_elapsed_ns(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+// The parsers that were used before fastparse, kept here as the baseline
+static time_t reference_parse_iso8601_utc(const char *timestr)
+{
+    struct tm tm = {0};
+    int year, month, day, hour, min, sec;
+
+    if (sscanf(timestr, "%4d-%2d-%2dT%2d:%2d:%2d",
+               &year, &month, &day, &hour, &min, &sec) != 6)
+    {
+        return (time_t)-1;
+    }
+
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    tm.tm_isdst = 0;
+    return timegm(&tm);
+}
+
+static void bench_report(const char *name, double reference_ns, double fast_ns, int samples, int mismatches)
+{
+    printf("%-12s reference: %7.1f ns/op   fastparse: %7.1f ns/op   speedup: %5.1fx   mismatches: %d\n",
+           name, reference_ns / samples, fast_ns / samples, reference_ns / fast_ns, mismatches);
+}
+
+static void bench_decimal(const char *name, char (*strings)[BENCH_STRING_SIZE], int samples)
+{
+    struct timespec start;
+    double reference_sum = 0.0;
+    double fast_sum = 0.0;
+    int mismatches = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < samples; i++)
+        reference_sum += atof(strings[i]);
+    double reference_ns = bench_elapsed_ns(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < samples; i++)
+    {
+        double value = 0.0;
+        fastparse_decimal(strings[i], strlen(strings[i]), &value);
+        fast_sum += value;
+    }
+    double fast_ns = bench_elapsed_ns(&start);
+
+    for (int i = 0; i < samples; i++)
+    {
+        double value = 0.0;
+        fastparse_decimal(strings[i], strlen(strings[i]), &value);
+        if (value != atof(strings[i]))
+            mismatches++;
+    }
+
+    bench_report(name, reference_ns, fast_ns, samples, mismatches);
+    if (reference_sum != fast_sum)
+        printf("%-12s checksums differ: %f vs %f\n", name, reference_sum, fast_sum);
+}
+
+static void bench_iso8601(char (*strings)[BENCH_STRING_SIZE], int samples)
+{
+    struct timespec start;
+    long long reference_sum = 0;
+    long long fast_sum = 0;
+    int mismatches = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < samples; i++)
+        reference_sum += reference_parse_iso8601_utc(strings[i]);
+    double reference_ns = bench_elapsed_ns(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < samples; i++)
+    {
+        time_t value = (time_t)-1;
+        fastparse_iso8601(strings[i], strlen(strings[i]), &value);
+        fast_sum += value;
+    }
+    double fast_ns = bench_elapsed_ns(&start);
+
+    for (int i = 0; i < samples; i++)
+    {
+        time_t value = (time_t)-1;
+        fastparse_iso8601(strings[i], strlen(strings[i]), &value);
+        if (value != reference_parse_iso8601_utc(strings[i]))
+            mismatches++;
+    }
+
+    bench_report("iso8601", reference_ns, fast_ns, samples, mismatches);
+    if (reference_sum != fast_sum)
+        printf("%-12s checksums differ\n", "iso8601");
+}
+
+int main(int argc, char *argv[])
+{
+    int samples = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_SAMPLES;
+    if (samples <= 0)
+    {
+        printf("usage: %s [samples]\n", argv[0]);
+        return 1;
+    }
+
+    char (*coords)[BENCH_STRING_SIZE] = malloc((size_t)samples * BENCH_STRING_SIZE);
+    char (*elevations)[BENCH_STRING_SIZE] = malloc((size_t)samples * BENCH_STRING_SIZE);
+    char (*timestamps)[BENCH_STRING_SIZE] = malloc((size_t)samples * BENCH_STRING_SIZE);
+    if (!coords || !elevations || !timestamps)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    // samples look like what Garmin exports contain
+    srand(42);
+    time_t base = 1600000000;
+    for (int i = 0; i < samples; i++)
+    {
+        double coord = -180.0 + 360.0 * rand() / (double)RAND_MAX;
+        snprintf(coords[i], BENCH_STRING_SIZE, "%.7f", coord);
+        snprintf(elevations[i], BENCH_STRING_SIZE, "%.1f", -50.0 + 3000.0 * rand() / (double)RAND_MAX);
+
+        time_t t = base + (time_t)rand() % 300000000;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(timestamps[i], BENCH_STRING_SIZE, i % 2 ? "%Y-%m-%dT%H:%M:%SZ" : "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+    }
+
+    printf("Parsing %d samples per parser\n", samples);
+    bench_decimal("coordinate", coords, samples);
+    bench_decimal("elevation", elevations, samples);
+    bench_iso8601(timestamps, samples);
+
+    free(coords);
+    free(elevations);
+    free(timestamps);
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "corpus.h"
+
+// Synthetic GPX corpus for benchmarks. Tracks follow a limited number of shared routes, each with its own
+// lane offset, GPS noise and pauses where the watch keeps recording on the spot, so the heat and the
+// tile renderer see overlapping tracks like in a real collection.
+
+typedef struct
+{
+    double *north; // meters from the corpus center
+    double *east;
+    float *elevation;
+    int count;
+} CorpusRoute;
+
+static uint64_t corpus_next(uint64_t *state)
+{
+    // xorshift64*, the corpus has to be the same on every platform for a given seed
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, 1)
+static double corpus_uniform(uint64_t *state)
+{
+    return (corpus_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static bool corpus_build_route(CorpusRoute *route, int count, uint64_t *state)
+{
+    route->north = (double *)malloc(count * sizeof(double));
+    route->east = (double *)malloc(count * sizeof(double));
+    route->elevation = (float *)malloc(count * sizeof(float));
+    route->count = count;
+    if (!route->north || !route->east || !route->elevation)
+    {
+        perror("malloc");
+        return false;
+    }
+
+    double north = (corpus_uniform(state) - 0.5) * CORPUS_AREA_METERS;
+    double east = (corpus_uniform(state) - 0.5) * CORPUS_AREA_METERS;
+    double heading = corpus_uniform(state) * 2.0 * M_PI;
+    double phase1 = corpus_uniform(state) * 2.0 * M_PI;
+    double phase2 = corpus_uniform(state) * 2.0 * M_PI;
+
+    for (int i = 0; i < count; i++)
+    {
+        route->north[i] = north;
+        route->east[i] = east;
+        double s = i * CORPUS_STEP_METERS;
+        route->elevation[i] = (float)(120.0 + 40.0 * sin(s / 700.0 + phase1) + 8.0 * sin(s / 170.0 + phase2));
+
+        // gentle curves and now and then a turn at a crossing
+        heading += (corpus_uniform(state) - 0.5) * 0.2;
+        if (corpus_uniform(state) < 0.005)
+            heading += (corpus_uniform(state) < 0.5 ? -0.5 : 0.5) * M_PI;
+        north += cos(heading) * CORPUS_STEP_METERS;
+        east += sin(heading) * CORPUS_STEP_METERS;
+    }
+    return true;
+}
+
+static void corpus_free_route(CorpusRoute *route)
+{
+    free(route->north);
+    free(route->east);
+    free(route->elevation);
+}
+
+static bool corpus_write_track(const char *path, const CorpusRoute *route, int index, int length, uint64_t *state)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+    char buffer[1 << 16];
+    setvbuf(f, buffer, _IOFBF, sizeof(buffer));
+
+    double type = corpus_uniform(state);
+    const char *type_name = type < 0.7 ? "Running" : type < 0.85 ? "Cycling" : "Hiking";
+
+    // one track every six hours from 2020 on, one point per second
+    time_t start_time = 1577836800 + (time_t)index * 6 * 3600 + 7 * 3600;
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<gpx creator=\"footprints corpus\" version=\"1.1\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+               "  <trk>\n    <name>bench %d</name>\n    <type>%s</type>\n    <trkseg>\n",
+            index, type_name);
+
+    int first = route->count > length ? (int)(corpus_uniform(state) * (route->count - length + 1)) : 0;
+    bool reverse = corpus_uniform(state) < 0.5;
+    double lane_north = (corpus_uniform(state) - 0.5) * 6.0;
+    double lane_east = (corpus_uniform(state) - 0.5) * 6.0;
+    double meters_per_deg_lon = 111320.0 * cos(CORPUS_CENTER_LAT * M_PI / 180.0);
+
+    int step = 0;
+    int pause_left = 0;
+    for (int written = 0; written < length; written++)
+    {
+        int offset = step < length ? step : length - 1;
+        int r = reverse ? first + length - 1 - offset : first + offset;
+        if (r >= route->count)
+            r = route->count - 1;
+
+        double north = route->north[r] + lane_north + (corpus_uniform(state) - 0.5) * 3.0;
+        double east = route->east[r] + lane_east + (corpus_uniform(state) - 0.5) * 3.0;
+        double lat = CORPUS_CENTER_LAT + north / 111320.0;
+        double lon = CORPUS_CENTER_LON + east / meters_per_deg_lon;
+        float elevation = route->elevation[r] + (float)(corpus_uniform(state) - 0.5);
+
+        time_t t = start_time + written;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+        fprintf(f, "      <trkpt lat=\"%.7f\" lon=\"%.7f\">\n        <ele>%.1f</ele>\n        <time>%s</time>\n      </trkpt>\n",
+                lat, lon, elevation, time_str);
+
+        // waiting at a traffic light: the position stays, only the noise moves it
+        if (pause_left > 0)
+            pause_left--;
+        else if (corpus_uniform(state) < 1.0 / 300.0)
+            pause_left = 5 + (int)(corpus_uniform(state) * 55);
+        else
+            step++;
+    }
+
+    fprintf(f, "    </trkseg>\n  </trk>\n</gpx>\n");
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+// Write total_tracks GPX files with about points_per_track points each to folder_path
+bool corpus_generate(const char *folder_path, int total_tracks, int points_per_track, uint64_t seed)
+{
+    if (mkdir(folder_path, 0755) != 0 && errno != EEXIST)
+    {
+        perror(folder_path);
+        return false;
+    }
+
+    uint64_t state = seed ? seed : 1;
+    int total_routes = total_tracks / CORPUS_TRACKS_PER_ROUTE;
+    if (total_routes < 1)
+        total_routes = 1;
+    if (total_routes > 1000)
+        total_routes = 1000;
+
+    // routes are longer than the tracks, which start at different places along them
+    int route_length = points_per_track * 2;
+    CorpusRoute *routes = (CorpusRoute *)calloc(total_routes, sizeof(CorpusRoute));
+    if (!routes)
+    {
+        perror("calloc");
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; ok && i < total_routes; i++)
+        ok = corpus_build_route(&routes[i], route_length, &state);
+
+    long long total_points = 0;
+    for (int i = 0; ok && i < total_tracks; i++)
+    {
+        const CorpusRoute *route = &routes[corpus_next(&state) % total_routes];
+        int length = (int)(points_per_track * (0.5 + corpus_uniform(&state)));
+        if (length < 2)
+            length = 2;
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/bench_%06d.gpx", folder_path, i);
+        ok = corpus_write_track(path, route, i, length, &state);
+        total_points += length;
+
+        if ((i + 1) % 1000 == 0)
+            printf("Wrote %d of %d tracks\n", i + 1, total_tracks);
+    }
+
+    for (int i = 0; i < total_routes; i++)
+        corpus_free_route(&routes[i]);
+    free(routes);
+
+    if (ok)
+        printf("Corpus in %s: %d tracks on %d routes, %lld points\n", folder_path, total_tracks, total_routes, total_points);
+    return ok;
+}
@@ -0,0 +1,22 @@
+#ifndef corpus_h
+#define corpus_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define CORPUS_CENTER_LAT 51.71909 // routes are spread around Paderborn, like the default map position
+#define CORPUS_CENTER_LON 8.80673
+#define CORPUS_AREA_METERS 20000.0 // side length of the square the routes start in
+#define CORPUS_STEP_METERS 3.0     // distance between two route points, running pace at one point per second
+#define CORPUS_TRACKS_PER_ROUTE 20 // how many tracks share one route on average
+
+bool corpus_generate(const char *folder_path, int total_tracks, int points_per_track, uint64_t seed);
+
+#endif
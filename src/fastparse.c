@@ -0,0 +1,130 @@
+#include "fastparse.h"
+
+// Powers of ten that are exact in a double
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Copy to a small stack buffer and let strtod deal with the unusual cases
+static bool fastparse_decimal_slow(const char *str, size_t length, double *out)
+{
+    char buffer[64];
+    if (length >= sizeof(buffer))
+        return false;
+    memcpy(buffer, str, length);
+    buffer[length] = '\0';
+
+    char *end;
+    *out = strtod(buffer, &end);
+    return end != buffer && *end == '\0';
+}
+
+// Parse "[+-]digits[.digits]" surrounded by optional whitespace.
+// Up to 15 significant digits the result is exactly what strtod returns:
+// both the digits and the power of ten are exact doubles and a single
+// IEEE division rounds correctly.
+bool fastparse_decimal(const char *str, size_t length, double *out)
+{
+    const char *p = str;
+    const char *end = str + length;
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+
+    const char *number = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction_digits = 0;
+    bool seen_point = false;
+    for (; p < end; p++)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits++;
+            if (seen_point)
+                fraction_digits++;
+        }
+        else if (*p == '.' && !seen_point)
+        {
+            seen_point = true;
+        }
+        else
+        {
+            // exponents and anything else
+            return fastparse_decimal_slow(number, end - number, out);
+        }
+    }
+
+    if (digits == 0)
+        return false;
+    if (digits > 15)
+        return fastparse_decimal_slow(number, end - number, out);
+
+    double value = (double)mantissa;
+    if (fraction_digits > 0)
+        value /= exact_powers_of_ten[fraction_digits];
+    *out = negative ? -value : value;
+    return true;
+}
+
+static bool fastparse_digits(const char *p, int count, int *out)
+{
+    int value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (p[i] < '0' || p[i] > '9')
+            return false;
+        value = value * 10 + (p[i] - '0');
+    }
+    *out = value;
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t fastparse_days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// Parse "YYYY-MM-DDTHH:MM:SS" as UTC. Fractional seconds and the zone designator
+// that may follow are ignored, just like the sscanf based parsers did.
+bool fastparse_iso8601(const char *str, size_t length, time_t *out)
+{
+    while (length > 0 && (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r'))
+    {
+        str++;
+        length--;
+    }
+    if (length < 19)
+        return false;
+    if (str[4] != '-' || str[7] != '-' || str[10] != 'T' || str[13] != ':' || str[16] != ':')
+        return false;
+
+    int year, month, day, hour, minute, second;
+    if (!fastparse_digits(str, 4, &year) || !fastparse_digits(str + 5, 2, &month) ||
+        !fastparse_digits(str + 8, 2, &day) || !fastparse_digits(str + 11, 2, &hour) ||
+        !fastparse_digits(str + 14, 2, &minute) || !fastparse_digits(str + 17, 2, &second))
+        return false;
+
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return false;
+
+    int64_t days = fastparse_days_from_civil(year, month, day);
+    *out = (time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef fastparse_h
+#define fastparse_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Number and timestamp parsers for string slices that are not null terminated.
+// They never allocate and never look at the locale.
+
+bool fastparse_decimal(const char *str, size_t length, double *out);
+bool fastparse_iso8601(const char *str, size_t length, time_t *out);
+
+#endif
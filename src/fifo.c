@@ -74,7 +74,7 @@ bool fifo_search_data(struct fifo *fifo, MapTile searchData)
 
 void fifo_increment_pointer(int *fifo_pointer)
 {
-    if (*fifo_pointer < FIFO_DEPTH)
+    if (*fifo_pointer < FIFO_DEPTH - 1)
     {
         (*fifo_pointer)++;
     }
@@ -88,7 +88,7 @@ bool fifo_is_full(struct fifo *fifo)
 {
     // isFull = true when only one space is left
     bool isFull = false;
-    if (fifo->write_p == FIFO_DEPTH && fifo->read_p == 0)
+    if (fifo->write_p == FIFO_DEPTH - 1 && fifo->read_p == 0)
     {
         isFull = true;
     }
@@ -102,4 +102,10 @@ bool fifo_is_full(struct fifo *fifo)
 bool fifo_is_empty(struct fifo *fifo)
 {
     return fifo->write_p == fifo->read_p;
+}
+
+// number of tiles waiting, the caller holds the lock
+int fifo_depth(struct fifo *fifo)
+{
+    return (fifo->write_p - fifo->read_p + FIFO_DEPTH) % FIFO_DEPTH;
 }
\ No newline at end of file
@@ -14,5 +14,6 @@ bool fifo_write_data(struct fifo *fifo, MapTile writeData);
 bool fifo_search_data(struct fifo *fifo, MapTile searchData);
 bool fifo_is_empty(struct fifo *fifo);
 bool fifo_is_full(struct fifo *fifo);
+int fifo_depth(struct fifo *fifo);
 
 #endif
\ No newline at end of file
@@ -14,29 +14,13 @@ void reverse_chars(char *str, char *rv_str, int size)
 
 time_t parse_iso8601(const char *datetime)
 {
-  struct tm tm = {0};
-  int year, month, day, hour, minute, second;
-
-  if (sscanf(datetime, "%d-%d-%dT%d:%d:%dZ",
-             &year, &month, &day, &hour, &minute, &second) != 6)
+  time_t result;
+  if (!fastparse_iso8601(datetime, strlen(datetime), &result))
   {
     fprintf(stderr, "Invalid ISO 8601 format\n");
     return (time_t)-1;
   }
-
-  tm.tm_year = year - 1900; // tm_year is years since 1900
-  tm.tm_mon = month - 1;    // tm_mon is months since January [0-11]
-  tm.tm_mday = day;
-  tm.tm_hour = hour;
-  tm.tm_min = minute;
-  tm.tm_sec = second;
-
-  // Convert to UTC time_t
-#if defined(_WIN32) || defined(_WIN64)
-  return _mkgmtime(&tm); // Windows equivalent of timegm
-#else
-  return timegm(&tm); // Linux/macOS
-#endif
+  return result;
 }
 
 /**
@@ -98,14 +82,21 @@ void apply_filter_values(GpxCollection *c)
       c->tracks[i].visible_in_list = false;
     if (parse_iso8601(c->tracks[i].start_time_raw) < parse_european_date(c->filters.start_date_str_filter) || parse_iso8601(c->tracks[i].end_time_raw) > parse_european_date(c->filters.end_date_str_filter))
       c->tracks[i].visible_in_list = false;
+
+    // deleted from the gpx folder while running
+    if (c->tracks[i].removed)
+      c->tracks[i].visible_in_list = false;
   }
   int counter = 0;
+  int existing = 0;
   for (int i = 0; i < c->total_tracks; i++)
   {
     if (c->tracks[i].visible_in_list)
       counter++;
+    if (!c->tracks[i].removed)
+      existing++;
   }
-  sprintf(c->total_visible_tracks_str, "Shown: %d of %d Tracks", counter, c->total_tracks);
+  snprintf(c->total_visible_tracks_str, sizeof(c->total_visible_tracks_str), "Shown: %d of %d Tracks", counter, existing);
 }
 
 int digit(char c)
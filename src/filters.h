@@ -3,6 +3,7 @@
 
 #include <time.h>
 #include "structs.h"
+#include "fastparse.h"
 
 void apply_filter_values(GpxCollection *c);
 void reset_filters(FilterSettings *filter);
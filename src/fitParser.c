@@ -0,0 +1,279 @@
+#include "fitParser.h"
+
+// Decoder for Garmin FIT activity files. Only record messages (position, altitude,
+// timestamp) and the session sport are read, everything else is skipped by size.
+
+static uint32_t fitParser_read_uint(const uint8_t *p, int size, bool big_endian)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int shift = big_endian ? (size - 1 - i) * 8 : i * 8;
+        value |= (uint32_t)p[i] << shift;
+    }
+    return value;
+}
+
+static void fitParser_format_time(uint32_t fit_timestamp, char *out, size_t size)
+{
+    time_t t = (time_t)fit_timestamp + FIT_EPOCH_OFFSET;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(out, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static bool fitParser_read_definition(const uint8_t *p, const uint8_t *end, bool has_developer_fields, FitDefinition *def, const uint8_t **next)
+{
+    // reserved, architecture, global message number, number of fields
+    if (end - p < 5)
+        return false;
+
+    memset(def, 0, sizeof(*def));
+    def->defined = true;
+    def->big_endian = p[1] == 1;
+    def->global_message = (uint16_t)fitParser_read_uint(p + 2, 2, def->big_endian);
+    int num_fields = p[4];
+    p += 5;
+
+    def->timestamp_offset = def->lat_offset = def->lon_offset = -1;
+    def->altitude_offset = def->enhanced_altitude_offset = def->sport_offset = -1;
+
+    if (end - p < num_fields * 3)
+        return false;
+
+    int offset = 0;
+    for (int i = 0; i < num_fields; i++, p += 3)
+    {
+        int field = p[0];
+        int size = p[1];
+
+        if (field == FIT_FIELD_TIMESTAMP)
+        {
+            def->timestamp_offset = offset;
+            def->timestamp_size = size;
+        }
+        else if (def->global_message == FIT_MESG_RECORD)
+        {
+            if (field == FIT_FIELD_POSITION_LAT)
+            {
+                def->lat_offset = offset;
+                def->lat_size = size;
+            }
+            else if (field == FIT_FIELD_POSITION_LONG)
+            {
+                def->lon_offset = offset;
+                def->lon_size = size;
+            }
+            else if (field == FIT_FIELD_ALTITUDE)
+            {
+                def->altitude_offset = offset;
+                def->altitude_size = size;
+            }
+            else if (field == FIT_FIELD_ENHANCED_ALTITUDE)
+            {
+                def->enhanced_altitude_offset = offset;
+                def->enhanced_altitude_size = size;
+            }
+        }
+        else if (def->global_message == FIT_MESG_SESSION && field == FIT_FIELD_SPORT)
+        {
+            def->sport_offset = offset;
+            def->sport_size = size;
+        }
+        offset += size;
+    }
+
+    if (has_developer_fields)
+    {
+        if (end - p < 1)
+            return false;
+        int num_developer_fields = *p++;
+        if (end - p < num_developer_fields * 3)
+            return false;
+        for (int i = 0; i < num_developer_fields; i++, p += 3)
+            offset += p[1];
+    }
+
+    def->message_size = offset;
+    *next = p;
+    return true;
+}
+
+static bool fitParser_read_record(const uint8_t *p, FitDefinition *def, uint32_t timestamp, bool has_timestamp,
+                                  GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    if (def->lat_offset < 0 || def->lon_offset < 0 || def->lat_size != 4 || def->lon_size != 4)
+        return true;
+
+    int32_t lat_semicircles = (int32_t)fitParser_read_uint(p + def->lat_offset, 4, def->big_endian);
+    int32_t lon_semicircles = (int32_t)fitParser_read_uint(p + def->lon_offset, 4, def->big_endian);
+
+    // records without a fix carry the invalid value
+    if (lat_semicircles == 0x7FFFFFFF || lon_semicircles == 0x7FFFFFFF)
+        return true;
+
+    double lat = lat_semicircles * (180.0 / 2147483648.0);
+    double lon = lon_semicircles * (180.0 / 2147483648.0);
+    if (!gpxParser_append_point(track, buffer, lat, lon))
+        return false;
+
+    // altitude is stored with scale 5 and offset 500, enhanced_altitude fills in when it is missing
+    GpxPoint *pt = &track->points[track->total_points - 1];
+    uint32_t raw = 0xFFFFFFFF;
+    if (def->altitude_offset >= 0 && def->altitude_size == 2)
+    {
+        raw = fitParser_read_uint(p + def->altitude_offset, 2, def->big_endian);
+        if (raw == 0xFFFF)
+            raw = 0xFFFFFFFF;
+    }
+    if (raw == 0xFFFFFFFF && def->enhanced_altitude_offset >= 0 && def->enhanced_altitude_size == 4)
+        raw = fitParser_read_uint(p + def->enhanced_altitude_offset, 4, def->big_endian);
+    if (raw != 0xFFFFFFFF)
+        pt->elevation = raw / 5.0f - 500.0f;
+
+    if (has_timestamp)
+    {
+        if (!*found_time)
+        {
+            fitParser_format_time(timestamp, track->start_time_raw, sizeof(track->start_time_raw));
+            *found_time = true;
+        }
+        fitParser_format_time(timestamp, track->end_time_raw, sizeof(track->end_time_raw));
+    }
+    return true;
+}
+
+bool fitParser_parse_buffer(const uint8_t *data, size_t length, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    FitDefinition definitions[FIT_MAX_LOCAL_MESSAGES];
+    const uint8_t *file = data;
+    const uint8_t *file_end = data + length;
+    int sport = -1;
+
+    // a file can hold several FIT files chained back to back
+    while (file_end - file >= 12)
+    {
+        int header_size = file[0];
+        if ((header_size != 12 && header_size != 14) || file_end - file < header_size ||
+            memcmp(file + 8, ".FIT", 4) != 0)
+            break;
+
+        uint32_t data_size = fitParser_read_uint(file + 4, 4, false);
+        const uint8_t *p = file + header_size;
+        const uint8_t *end = p + data_size;
+        if (end > file_end)
+            return false;
+
+        memset(definitions, 0, sizeof(definitions));
+        uint32_t last_timestamp = 0;
+        bool has_last_timestamp = false;
+
+        while (p < end)
+        {
+            uint8_t header = *p++;
+            uint32_t timestamp = 0;
+            bool has_timestamp = false;
+            int local_message;
+
+            if (header & 0x80)
+            {
+                // compressed timestamp header: 5 bit offset to the last full timestamp
+                local_message = (header >> 5) & 0x03;
+                uint32_t offset = header & 0x1F;
+                if (has_last_timestamp)
+                {
+                    timestamp = (last_timestamp & ~0x1Fu) + offset;
+                    if (offset < (last_timestamp & 0x1Fu))
+                        timestamp += 0x20;
+                    last_timestamp = timestamp;
+                    has_timestamp = true;
+                }
+            }
+            else if (header & 0x40)
+            {
+                local_message = header & 0x0F;
+                if (!fitParser_read_definition(p, end, (header & 0x20) != 0, &definitions[local_message], &p))
+                    return false;
+                continue;
+            }
+            else
+            {
+                local_message = header & 0x0F;
+            }
+
+            FitDefinition *def = &definitions[local_message];
+            if (!def->defined || end - p < def->message_size)
+                return false;
+
+            if (def->timestamp_offset >= 0 && def->timestamp_size == 4)
+            {
+                uint32_t raw = fitParser_read_uint(p + def->timestamp_offset, 4, def->big_endian);
+                if (raw != 0xFFFFFFFF)
+                {
+                    timestamp = raw;
+                    last_timestamp = raw;
+                    has_last_timestamp = true;
+                    has_timestamp = true;
+                }
+            }
+
+            if (def->global_message == FIT_MESG_RECORD)
+            {
+                if (!fitParser_read_record(p, def, timestamp, has_timestamp, track, buffer, found_time))
+                    return false;
+            }
+            else if (def->global_message == FIT_MESG_SESSION && def->sport_offset >= 0 && def->sport_size == 1 && sport < 0)
+            {
+                if (p[def->sport_offset] != 0xFF)
+                    sport = p[def->sport_offset];
+            }
+            p += def->message_size;
+        }
+
+        // skip the file CRC
+        file = end + 2;
+    }
+
+    // same rules as convert_fit_to_gpx.py: no sport, training and swimming are not imported
+    if (sport < 0 || sport == FIT_SPORT_TRAINING || sport == FIT_SPORT_SWIMMING || track->total_points == 0)
+        return false;
+
+    if (sport == FIT_SPORT_RUNNING)
+        track->act_type = Run;
+    else if (sport == FIT_SPORT_CYCLING)
+        track->act_type = Cycling;
+    else if (sport == FIT_SPORT_HIKING)
+        track->act_type = Hike;
+    else
+        track->act_type = Other;
+    return true;
+}
+
+bool fitParser_parse_file(const char *filename, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    bool parsed = fitParser_parse_buffer((const uint8_t *)data, st.st_size, track, buffer, found_time);
+    munmap(data, st.st_size);
+    return parsed;
+}
@@ -0,0 +1,40 @@
+#ifndef fitParser_h
+#define fitParser_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "structs.h"
+#include "pointarena.h"
+
+#define FIT_EPOCH_OFFSET 631065600 // 1989-12-31T00:00:00Z in unix time
+#define FIT_MAX_LOCAL_MESSAGES 16
+
+#define FIT_MESG_SESSION 18
+#define FIT_MESG_RECORD 20
+
+#define FIT_FIELD_TIMESTAMP 253
+#define FIT_FIELD_POSITION_LAT 0
+#define FIT_FIELD_POSITION_LONG 1
+#define FIT_FIELD_ALTITUDE 2
+#define FIT_FIELD_ENHANCED_ALTITUDE 78
+#define FIT_FIELD_SPORT 5
+
+#define FIT_SPORT_RUNNING 1
+#define FIT_SPORT_CYCLING 2
+#define FIT_SPORT_SWIMMING 5
+#define FIT_SPORT_TRAINING 10
+#define FIT_SPORT_HIKING 17
+
+bool fitParser_parse_buffer(const uint8_t *data, size_t length, GpxTrack *track, PointBuffer *buffer, bool *found_time);
+bool fitParser_parse_file(const char *filename, GpxTrack *track, PointBuffer *buffer, bool *found_time);
+
+// implemented in gpxParser.c, shared by all parsers
+bool gpxParser_append_point(GpxTrack *track, PointBuffer *buffer, double lat, double lon);
+
+#endif
@@ -0,0 +1,347 @@
+#define _GNU_SOURCE // memmem
+#include "gpxFastParser.h"
+
+// Zero-copy tokenizer for the plain GPX files written by Garmin and convert_fit_to_gpx.py.
+// It only understands the subset of XML these files use. Whenever it sees something
+// outside of that subset (CDATA, DOCTYPE, entities, prefixed GPX elements, encodings other
+// than UTF-8) it gives up and the caller falls back to the libxml2 reader.
+
+typedef enum
+{
+    TAG_OTHER,
+    TAG_TRKPT,
+    TAG_ELE,
+    TAG_TIME,
+    TAG_TYPE,
+} GpxTag;
+
+// Find the next occurrence of c, 16 bytes at a time where SSE2 is available
+static const char *gpxFast_find_char(const char *p, const char *end, char c)
+{
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end)
+    {
+        if (*p == c)
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+static bool gpxFast_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool gpxFast_is_name_end(char c)
+{
+    return gpxFast_is_space(c) || c == '>' || c == '/';
+}
+
+static GpxTag gpxFast_classify(const char *name, size_t length)
+{
+    if (length == 5 && memcmp(name, "trkpt", 5) == 0)
+        return TAG_TRKPT;
+    if (length == 3 && memcmp(name, "ele", 3) == 0)
+        return TAG_ELE;
+    if (length == 4 && memcmp(name, "time", 4) == 0)
+        return TAG_TIME;
+    if (length == 4 && memcmp(name, "type", 4) == 0)
+        return TAG_TYPE;
+    return TAG_OTHER;
+}
+
+// End of a start tag, skipping '>' inside quoted attribute values
+static const char *gpxFast_find_tag_end(const char *p, const char *end)
+{
+    while (p < end)
+    {
+        if (*p == '>')
+            return p;
+        if (*p == '"' || *p == '\'')
+        {
+            p = gpxFast_find_char(p + 1, end, *p);
+            if (!p)
+                return NULL;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+// Character data of an element: everything up to the next '<'. Entities are not decoded.
+static const char *gpxFast_text(const char *p, const char *end, const char **text_end)
+{
+    *text_end = gpxFast_find_char(p, end, '<');
+    if (!*text_end || memchr(p, '&', *text_end - p))
+        return NULL;
+    return p;
+}
+
+static bool gpxFast_parse_trkpt_attributes(const char *p, const char *tag_end, double *lat, double *lon)
+{
+    bool has_lat = false;
+    bool has_lon = false;
+
+    while (p < tag_end)
+    {
+        while (p < tag_end && (gpxFast_is_space(*p) || *p == '/'))
+            p++;
+        if (p >= tag_end)
+            break;
+
+        const char *name = p;
+        while (p < tag_end && *p != '=' && !gpxFast_is_space(*p))
+            p++;
+        size_t name_length = p - name;
+        while (p < tag_end && gpxFast_is_space(*p))
+            p++;
+        if (p >= tag_end || *p != '=')
+            return false;
+        p++;
+        while (p < tag_end && gpxFast_is_space(*p))
+            p++;
+        if (p >= tag_end || (*p != '"' && *p != '\''))
+            return false;
+
+        const char *value = p + 1;
+        const char *value_end = gpxFast_find_char(value, tag_end, *p);
+        if (!value_end)
+            return false;
+
+        bool is_lat = name_length == 3 && memcmp(name, "lat", 3) == 0;
+        bool is_lon = name_length == 3 && memcmp(name, "lon", 3) == 0;
+        if (is_lat || is_lon)
+        {
+            double number;
+            if (!fastparse_decimal(value, value_end - value, &number))
+                return false;
+            if (is_lat)
+            {
+                *lat = number;
+                has_lat = true;
+            }
+            else
+            {
+                *lon = number;
+                has_lon = true;
+            }
+        }
+        p = value_end + 1;
+    }
+    return has_lat && has_lon;
+}
+
+// Only ASCII compatible documents can be tokenized byte by byte: UTF-16 and UTF-32 files,
+// with or without byte order mark, start with a zero or a BOM byte.
+static bool gpxFast_is_ascii_compatible(const unsigned char *data, size_t length)
+{
+    if (length >= 2 && (data[0] == 0 || data[1] == 0))
+        return false;
+    if (length >= 2 && ((data[0] == 0xFE && data[1] == 0xFF) || (data[0] == 0xFF && data[1] == 0xFE)))
+        return false;
+    return true;
+}
+
+// The encoding pseudo attribute of the XML declaration <?xml ... ?>, which has to be UTF-8 or
+// its ASCII subset. No declaration or no encoding means UTF-8.
+static bool gpxFast_check_declaration(const char *p, const char *declaration_end)
+{
+    if (declaration_end - p < 4 || memcmp(p, "xml", 3) != 0 || !gpxFast_is_space(p[3]))
+        return true;
+
+    const char *encoding = memmem(p, declaration_end - p, "encoding", 8);
+    if (!encoding)
+        return true;
+    p = encoding + 8;
+    while (p < declaration_end && (gpxFast_is_space(*p) || *p == '='))
+        p++;
+    if (p >= declaration_end || (*p != '"' && *p != '\''))
+        return false;
+
+    const char *value = p + 1;
+    const char *value_end = gpxFast_find_char(value, declaration_end, *p);
+    if (!value_end)
+        return false;
+    size_t value_length = value_end - value;
+    static const char *accepted[] = {"UTF-8", "UTF8", "US-ASCII", "ASCII"};
+    for (size_t i = 0; i < sizeof(accepted) / sizeof(accepted[0]); i++)
+    {
+        if (value_length == strlen(accepted[i]) && strncasecmp(value, accepted[i], value_length) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool gpxFast_parse_buffer(const char *data, size_t length, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    const char *p = data;
+    const char *end = data + length;
+    int depth = 0;        // open elements before the current tag
+    int trkpt_depth = -1; // depth of the open trkpt, ele and time count only as its direct children
+    bool found_type = false;
+
+    if (!gpxFast_is_ascii_compatible((const unsigned char *)data, length))
+        return false;
+
+    while ((p = gpxFast_find_char(p, end, '<')) != NULL)
+    {
+        p++;
+        if (p >= end)
+            return false;
+
+        if (*p == '?')
+        {
+            const char *declaration_end = memmem(p, end - p, "?>", 2);
+            if (!declaration_end || !gpxFast_check_declaration(p + 1, declaration_end))
+                return false;
+            p = declaration_end + 2;
+            continue;
+        }
+        if (*p == '!')
+        {
+            // comments are fine, CDATA sections and DOCTYPE declarations are left to libxml2
+            if (end - p < 3 || memcmp(p, "!--", 3) != 0)
+                return false;
+            p = memmem(p + 3, end - p - 3, "-->", 3);
+            if (!p)
+                return false;
+            p += 3;
+            continue;
+        }
+
+        bool closing = *p == '/';
+        if (closing)
+            p++;
+
+        const char *name = p;
+        while (p < end && !gpxFast_is_name_end(*p))
+            p++;
+        const char *colon = memchr(name, ':', p - name);
+        const char *local_name = colon ? colon + 1 : name;
+        GpxTag tag = gpxFast_classify(local_name, p - local_name);
+
+        // prefixed GPX elements need real namespace handling
+        if (colon && tag != TAG_OTHER)
+            return false;
+
+        const char *tag_end = gpxFast_find_tag_end(p, end);
+        if (!tag_end)
+            return false;
+        bool self_closing = tag_end[-1] == '/';
+        const char *content = tag_end + 1;
+        p = content;
+
+        if (closing)
+        {
+            depth--;
+            if (depth == trkpt_depth)
+                trkpt_depth = -1;
+            continue;
+        }
+
+        int element_depth = depth;
+        if (!self_closing)
+            depth++;
+        bool trkpt_child = trkpt_depth >= 0 && element_depth == trkpt_depth + 1;
+
+        const char *text_end;
+        switch (tag)
+        {
+        case TAG_TRKPT:
+        {
+            double lat = 0.0, lon = 0.0;
+            if (!gpxFast_parse_trkpt_attributes(name + 5, tag_end, &lat, &lon))
+                return false;
+            if (!gpxParser_append_point(track, buffer, lat, lon))
+                return false;
+            if (!self_closing)
+                trkpt_depth = element_depth;
+            break;
+        }
+        case TAG_ELE:
+            if (trkpt_child && !self_closing)
+            {
+                if (!gpxFast_text(content, end, &text_end))
+                    return false;
+                // a malformed number is left to libxml2 instead of guessing a value here
+                double elevation;
+                if (!fastparse_decimal(content, text_end - content, &elevation))
+                    return false;
+                track->points[track->total_points - 1].elevation = elevation;
+            }
+            break;
+        case TAG_TIME:
+            if (trkpt_child && !self_closing)
+            {
+                if (!gpxFast_text(content, end, &text_end))
+                    return false;
+                size_t time_length = text_end - content;
+                if (time_length >= sizeof(track->end_time_raw))
+                    time_length = sizeof(track->end_time_raw) - 1;
+                if (!*found_time)
+                {
+                    memcpy(track->start_time_raw, content, time_length);
+                    track->start_time_raw[time_length] = '\0';
+                    *found_time = true;
+                }
+                memcpy(track->end_time_raw, content, time_length);
+                track->end_time_raw[time_length] = '\0';
+            }
+            break;
+        case TAG_TYPE:
+            if (!found_type && !self_closing)
+            {
+                if (!gpxFast_text(content, end, &text_end))
+                    return false;
+                char type_str[32];
+                size_t type_length = text_end - content;
+                if (type_length >= sizeof(type_str))
+                    type_length = sizeof(type_str) - 1;
+                memcpy(type_str, content, type_length);
+                type_str[type_length] = '\0';
+                track->act_type = gpxParser_activity_from_string(type_str);
+                found_type = true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool gpxFast_parse_file(const char *filename, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    bool parsed = gpxFast_parse_buffer((const char *)data, st.st_size, track, buffer, found_time);
+    munmap(data, st.st_size);
+    return parsed;
+}
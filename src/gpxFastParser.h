@@ -0,0 +1,25 @@
+#ifndef gpxFastParser_h
+#define gpxFastParser_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "structs.h"
+#include "fastparse.h"
+
+bool gpxFast_parse_buffer(const char *data, size_t length, GpxTrack *track, PointBuffer *buffer, bool *found_time);
+bool gpxFast_parse_file(const char *filename, GpxTrack *track, PointBuffer *buffer, bool *found_time);
+
+// implemented in gpxParser.c, shared by both parsers
+bool gpxParser_append_point(GpxTrack *track, PointBuffer *buffer, double lat, double lon);
+ActivityType gpxParser_activity_from_string(const char *type_str);
+
+#endif
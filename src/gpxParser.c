@@ -1,45 +1,19 @@
 #include "gpxParser.h"
 
-// Cross-platform ISO8601 parser: "YYYY-MM-DDTHH:MM:SS[.sss]Z"
-time_t parse_iso8601_utc(const char *timestr)
-{
-    struct tm tm = {0};
-    int year, month, day, hour, min, sec;
-
-    // Parse time up to seconds — ignore milliseconds and 'Z'
-    if (sscanf(timestr, "%4d-%2d-%2dT%2d:%2d:%2d",
-               &year, &month, &day, &hour, &min, &sec) != 6)
-    {
-        return (time_t)-1;
-    }
-
-    tm.tm_year = year - 1900; // years since 1900
-    tm.tm_mon = month - 1;    // months since January [0-11]
-    tm.tm_mday = day;
-    tm.tm_hour = hour;
-    tm.tm_min = min;
-    tm.tm_sec = sec;
-    tm.tm_isdst = 0; // not daylight saving time
+extern bool use_fast_gpx_parser;
 
-#if defined(_WIN32) || defined(_WIN64)
-    // Windows: mktime() is local time, so correct for UTC manually
-    time_t local = mktime(&tm);
-    if (local == (time_t)-1)
-        return (time_t)-1;
+// how often the mmap fast path and the libxml2 fallback were taken
+static atomic_int fast_path_files;
+static atomic_int fit_files;
+static atomic_int fallback_files;
 
-    // Convert to UTC manually
-    struct tm *gmt = gmtime(&local);
-    if (!gmt)
+// ISO8601 parser: "YYYY-MM-DDTHH:MM:SS[.sss]Z", always UTC
+time_t parse_iso8601_utc(const char *timestr)
+{
+    time_t result;
+    if (!fastparse_iso8601(timestr, strlen(timestr), &result))
         return (time_t)-1;
-
-    time_t local_as_utc = mktime(gmt);
-    time_t offset = difftime(local_as_utc, local);
-
-    return local - offset;
-#else
-    // Linux/macOS: use timegm() if available
-    return timegm(&tm);
-#endif
+    return result;
 }
 
 bool format_iso8601_display_strings(const char *iso8601, char *out_date, size_t date_size, char *out_time, size_t time_size)
@@ -103,49 +77,6 @@ void gpxTrack_CalculateDistance(GpxTrack *track)
     track->distance = track->distance / 1000; // meters to kilometers
 }
 
-bool gpxParser_extract_time(xmlNode *node, GpxTrack *track, bool *found_start_time)
-{
-    bool found_time = false;
-
-    for (xmlNode *cur_node = node; cur_node; cur_node = cur_node->next)
-    {
-        if (cur_node->type == XML_ELEMENT_NODE &&
-            xmlStrcmp(cur_node->name, (const xmlChar *)"trkpt") == 0)
-        {
-            for (xmlNode *child = cur_node->children; child; child = child->next)
-            {
-                if (child->type == XML_ELEMENT_NODE &&
-                    xmlStrcmp(child->name, (const xmlChar *)"time") == 0)
-                {
-                    xmlChar *time_content = xmlNodeGetContent(child);
-                    if (time_content)
-                    {
-                        if (!*found_start_time)
-                        {
-                            strncpy(track->start_time_raw, (const char *)time_content, sizeof(track->start_time_raw) - 1);
-                            track->start_time_raw[sizeof(track->start_time_raw) - 1] = '\0';
-                            *found_start_time = true;
-                        }
-
-                        // Always update end time with the latest <time>
-                        strncpy(track->end_time_raw, (const char *)time_content, sizeof(track->end_time_raw) - 1);
-                        track->end_time_raw[sizeof(track->end_time_raw) - 1] = '\0';
-
-                        xmlFree(time_content);
-                        found_time = true;
-                    }
-                }
-            }
-        }
-
-        // Recurse into children
-        if (gpxParser_extract_time(cur_node->children, track, found_start_time))
-            found_time = true;
-    }
-
-    return found_time;
-}
-
 void latLonToPixel(double lat, double lon, int zoom, int *x, int *y)
 {
     double lat_rad = lat * (double)M_PI / 180.0f;
@@ -166,111 +97,168 @@ void latLonToPixel(double lat, double lon, int zoom, int *x, int *y)
     *y = (int)(world_y * scale);
 }
 
-bool gpxParser_extract_act_type(xmlNode *node, GpxTrack *track)
+// Inverse of latLonToPixel, for the center of the pixel
+void pixelToLatLon(int x, int y, int zoom, double *lat, double *lon)
 {
-    for (xmlNode *cur_node = node; cur_node; cur_node = cur_node->next)
-    {
-        if (cur_node->type == XML_ELEMENT_NODE)
-        {
-            if (xmlStrcmp(cur_node->name, (const xmlChar *)"type") == 0)
-            {
-                if (cur_node->children && cur_node->children->content)
-                {
-                    char *type_str = (char *)cur_node->children->content;
+    double scale = (double)TILE_SIZE * (1 << zoom);
+    *lon = (x + 0.5) / scale * 360.0 - 180.0;
+    *lat = atan(sinh(M_PI * (1.0 - 2.0 * (y + 0.5) / scale))) * 180.0 / M_PI;
+}
 
-                    if (strcmp(type_str, "Running") == 0){
-                        track->act_type = Run;
-                        printf("run\n");
-                    }
-                    else if (strcmp(type_str, "Hiking") == 0 || strcmp(type_str, "hiking") == 0){
-                        track->act_type = Hike;
-                        printf("hike\n");
-                    }
-                    else if (strcmp(type_str, "Cycling") == 0){
-                        track->act_type = Cycling;
-                        printf("cycle\n");
-                    }
-                    else
-                        track->act_type = Other;
-                }
-                return true; // found <type>, done
-            }
-        }
+ActivityType gpxParser_activity_from_string(const char *type_str)
+{
+    if (strcmp(type_str, "Running") == 0)
+        return Run;
+    if (strcmp(type_str, "Hiking") == 0 || strcmp(type_str, "hiking") == 0)
+        return Hike;
+    if (strcmp(type_str, "Cycling") == 0)
+        return Cycling;
+    return Other;
+}
 
-        // Recurse into children
-        gpxParser_extract_act_type(cur_node->children, track);
-    }
+// Which text content the reader is currently collecting
+typedef enum
+{
+    FIELD_NONE,
+    FIELD_TYPE,
+    FIELD_ELE,
+    FIELD_TIME,
+} GpxField;
+
+bool gpxParser_append_point(GpxTrack *track, PointBuffer *buffer, double lat, double lon)
+{
+    if (!pointBuffer_reserve(buffer, track->total_points + 1))
+        return false;
+    track->points = buffer->points;
+
+    GpxPoint *pt = &track->points[track->total_points++];
+    pt->lat = lat;
+    pt->lon = lon;
+    latLonToPixel(lat, lon, MAX_ZOOM, &pt->world_x, &pt->world_y);
+    pt->track_id = track->track_id;
+    pt->heat = 1;
+    pt->elevation = 0.0;
+    pt->partial_distance = 0.0;
     return true;
 }
 
-bool gpxParser_extract_coords(xmlNode *node, GpxTrack *track)
+// Single forward pass over the document: activity type, coordinates, elevation and
+// timestamps are picked up as the reader streams past them, no DOM is built.
+bool gpxParser_stream_track(xmlTextReaderPtr reader, GpxTrack *track, PointBuffer *buffer, bool *found_time)
 {
-    for (xmlNode *cur_node = node; cur_node; cur_node = cur_node->next)
-    {
-        if (cur_node->type == XML_ELEMENT_NODE && xmlStrcmp(cur_node->name, (const xmlChar *)"trkpt") == 0)
-        {
-            int new_total = track->total_points + 1;
-            GpxPoint *temp = (GpxPoint *)realloc(track->points, new_total * sizeof(GpxPoint));
-            if (temp == NULL)
-            {
-                fprintf(stderr, "Memory reallocation for tracks failed.\n");
-                free(track);
-                return false;
-            }
-            track->total_points = new_total;
-            track->points = temp;
+    int trkpt_depth = -1;
+    bool found_type = false;
+    GpxField field = FIELD_NONE;
+    int ret;
 
-            xmlChar *s_lat = xmlGetProp(cur_node, (const xmlChar *)"lat");
-            xmlChar *s_lon = xmlGetProp(cur_node, (const xmlChar *)"lon");
+    while ((ret = xmlTextReaderRead(reader)) == 1)
+    {
+        int node_type = xmlTextReaderNodeType(reader);
 
-            double elevation = 0.0;
-            bool elevation_found = false;
+        if (node_type == XML_READER_TYPE_ELEMENT)
+        {
+            const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+            int depth = xmlTextReaderDepth(reader);
+            field = FIELD_NONE;
 
-            for (xmlNode *child = cur_node->children; child; child = child->next)
+            if (strcmp(name, "trkpt") == 0)
             {
-                if (child->type == XML_ELEMENT_NODE && xmlStrcmp(child->name, (const xmlChar *)"ele") == 0)
+                // the reader may reuse the buffer of a value for the next attribute,
+                // so each value is converted right away and only the number is kept
+                double lat = 0.0;
+                double lon = 0.0;
+                bool has_lat = false;
+                bool has_lon = false;
+                bool valid = true;
+                while (xmlTextReaderMoveToNextAttribute(reader) == 1)
                 {
-                    xmlChar *ele_content = xmlNodeGetContent(child);
-                    if (ele_content)
+                    const char *attr = (const char *)xmlTextReaderConstLocalName(reader);
+                    bool is_lat = strcmp(attr, "lat") == 0;
+                    if (!is_lat && strcmp(attr, "lon") != 0)
+                        continue;
+
+                    const char *value = (const char *)xmlTextReaderConstValue(reader);
+                    double number;
+                    if (!value || !fastparse_decimal(value, strlen(value), &number))
+                    {
+                        valid = false;
+                        continue;
+                    }
+                    if (is_lat)
+                    {
+                        lat = number;
+                        has_lat = true;
+                    }
+                    else
                     {
-                        elevation = atof((const char *)ele_content);
-                        elevation_found = true;
-                        xmlFree(ele_content);
-                        break;
+                        lon = number;
+                        has_lon = true;
                     }
                 }
+                bool has_coords = valid && has_lat && has_lon;
+                xmlTextReaderMoveToElement(reader);
+
+                if (has_coords)
+                {
+                    if (!gpxParser_append_point(track, buffer, lat, lon))
+                        return false;
+                    if (!xmlTextReaderIsEmptyElement(reader))
+                        trkpt_depth = depth;
+                }
+            }
+            else if (trkpt_depth >= 0 && depth == trkpt_depth + 1)
+            {
+                if (strcmp(name, "ele") == 0)
+                    field = FIELD_ELE;
+                else if (strcmp(name, "time") == 0)
+                    field = FIELD_TIME;
+            }
+            else if (!found_type && strcmp(name, "type") == 0)
+            {
+                field = FIELD_TYPE;
             }
+        }
+        else if (node_type == XML_READER_TYPE_TEXT || node_type == XML_READER_TYPE_CDATA)
+        {
+            const char *value = (const char *)xmlTextReaderConstValue(reader);
+            if (!value)
+                continue;
 
-            if (s_lat && s_lon)
+            if (field == FIELD_ELE)
             {
-                double lat = atof((const char *)s_lat);
-                double lon = atof((const char *)s_lon);
-                int world_x, world_y;
-                latLonToPixel(lat, lon, MAX_ZOOM, &world_x, &world_y);
-
-                GpxPoint *pt = &track->points[new_total - 1];
-                pt->lat = lat;
-                pt->lon = lon;
-                pt->world_x = world_x;
-                pt->world_y = world_y;
-                pt->track_id = track->track_id;
-                pt->heat = 1;
-
-                if (elevation_found)
-                    pt->elevation = elevation;
-                else
-                    pt->elevation = 0.0;
+                double elevation = 0.0;
+                fastparse_decimal(value, strlen(value), &elevation);
+                track->points[track->total_points - 1].elevation = elevation;
             }
+            else if (field == FIELD_TIME)
+            {
+                if (!*found_time)
+                {
+                    strncpy(track->start_time_raw, value, sizeof(track->start_time_raw) - 1);
+                    track->start_time_raw[sizeof(track->start_time_raw) - 1] = '\0';
+                    *found_time = true;
+                }
 
-            if (s_lat)
-                xmlFree(s_lat);
-            if (s_lon)
-                xmlFree(s_lon);
+                // Always update end time with the latest <time>
+                strncpy(track->end_time_raw, value, sizeof(track->end_time_raw) - 1);
+                track->end_time_raw[sizeof(track->end_time_raw) - 1] = '\0';
+            }
+            else if (field == FIELD_TYPE)
+            {
+                track->act_type = gpxParser_activity_from_string(value);
+                found_type = true;
+            }
+            field = FIELD_NONE;
+        }
+        else if (node_type == XML_READER_TYPE_END_ELEMENT)
+        {
+            field = FIELD_NONE;
+            if (trkpt_depth >= 0 && xmlTextReaderDepth(reader) == trkpt_depth)
+                trkpt_depth = -1;
         }
-
-        gpxParser_extract_coords(cur_node->children, track);
     }
-    return true;
+
+    return ret == 0;
 }
 
 void gpxTrack_calculate_mid_point(GpxTrack *track)
@@ -377,156 +365,593 @@ void gpxTrack_calculate_strings_for_UI(GpxTrack *track)
     snprintf(track->distance_str, sizeof(track->distance_str), "%.2f", track->distance);
 }
 
-bool gpxParser_parse_file(char *filename, GpxTrack *track)
+static void gpxParser_reset_track(GpxTrack *track)
 {
-    printf("Parsing: %s\n", filename);
-    xmlDocPtr doc;
-    xmlNode *root_element;
-    LIBXML_TEST_VERSION
-    // Parse the XML file
-    doc = xmlReadFile(filename, NULL, 0);
+    // the points live in the caller's scratch buffer, forget them
+    track->points = NULL;
+    track->total_points = 0;
+    track->act_type = Other;
+    track->distance = 0.0f;
+    track->elev_up = 0.0f;
+    track->elev_down = 0.0f;
+    track->high_point = 0.0f;
+    track->low_point = 0.0f;
+    track->duration_secs = 0.0f;
+    track->secs_per_km = 0.0f;
+    track->start_time_raw[0] = '\0';
+    track->end_time_raw[0] = '\0';
+}
 
-    if (doc == NULL)
+static bool gpxParser_read_with_libxml(char *filename, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    // gpxParser_init() has to be called once from the main thread before this runs on workers
+    xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, 0);
+    if (reader == NULL)
     {
         fprintf(stderr, "Failed to read %s\n", filename);
         return false;
     }
-    // Get the root element
-    root_element = xmlDocGetRootElement(doc);
 
-    // get activity type
-    gpxParser_extract_act_type(root_element, track);
+    bool parsed = gpxParser_stream_track(reader, track, buffer, found_time);
+    xmlFreeTextReader(reader);
+    return parsed;
+}
 
-    if (gpxParser_extract_coords(root_element, track))
+static bool gpxParser_read_memory_with_libxml(const char *name, const char *data, size_t length, GpxTrack *track, PointBuffer *buffer, bool *found_time)
+{
+    xmlTextReaderPtr reader = xmlReaderForMemory(data, (int)length, name, NULL, 0);
+    if (reader == NULL)
     {
+        fprintf(stderr, "Failed to read %s\n", name);
+        return false;
+    }
+
+    bool parsed = gpxParser_stream_track(reader, track, buffer, found_time);
+    xmlFreeTextReader(reader);
+    return parsed;
+}
 
+// .fit, also inside a gzip file (.fit.gz)
+static bool gpxParser_is_fit_file(const char *name)
+{
+    size_t length = strlen(name);
+    if (archive_is_gzip(name))
+        length -= 3;
+    return length > 4 && strncasecmp(name + length - 4, ".fit", 4) == 0;
+}
+
+// Everything that is calculated from the points, the same for all parsers
+static void gpxParser_finish_track(const char *name, GpxTrack *track, bool found_time)
+{
+    if (track->total_points > 0)
         gpxTrack_calculate_mid_point(track);
-        printf("Mid_x: %d, Mid_y: %d\n", track->mid_x, track->mid_y);
 
-        gpxTrack_CalculateDistance(track);
-        printf("Track distance: %.2f km\n", track->distance);
+    gpxTrack_CalculateDistance(track);
+    gpxTrack_calculate_elevation_gain_loss(track);
 
-        gpxTrack_calculate_elevation_gain_loss(track);
-        printf("Highest elevation: %.2f m\n", track->high_point);
-        printf("Lowest elevation: %.2f m\n", track->low_point);
-        printf("Total elevation up: %.2f m\n", track->elev_up);
-        printf("Total elevation down: %.2f m\n", track->elev_down);
+    if (found_time)
+    {
+        time_t start = parse_iso8601_utc(track->start_time_raw);
+        time_t end = parse_iso8601_utc(track->end_time_raw);
 
-        bool found_start_time = false;
-        if (gpxParser_extract_time(root_element, track, &found_start_time))
+        if (start != (time_t)-1 && end != (time_t)-1 && end >= start)
         {
-            time_t start = parse_iso8601_utc(track->start_time_raw);
-            time_t end = parse_iso8601_utc(track->end_time_raw);
+            track->duration_secs = difftime(end, start);
+            track->secs_per_km = track->duration_secs / track->distance;
+        }
+    }
 
-            if (start != (time_t)-1 && end != (time_t)-1 && end >= start)
-            {
-                track->duration_secs = difftime(end, start);
-                track->secs_per_km = track->duration_secs / track->distance;
-            }
-            else
-            {
-                track->duration_secs = 0.0f;
-                track->secs_per_km = 0.0f;
-            }
-            printf("start_time: %s\n", track->start_time_raw);
-            printf("end_time: %s\n", track->end_time_raw);
-            printf("duration_secs: %f\n", track->duration_secs);
-            printf("distance: %f\n", track->distance);
-            printf("secs_per_km: %f\n", track->secs_per_km);
+    printf("Parsed %s: %d points, %.2f km, %s\n", name, track->total_points, track->distance, track->start_time_raw);
+}
+
+bool gpxParser_parse_file(char *filename, GpxTrack *track, PointBuffer *buffer)
+{
+    gpxParser_reset_track(track);
+
+    bool found_time = false;
+    bool parsed = false;
+    if (gpxParser_is_fit_file(filename))
+    {
+        if (!fitParser_parse_file(filename, track, buffer, &found_time))
+        {
+            printf("Skipping %s (no GPS points, unsupported sport or damaged file)\n", filename);
+            return false;
         }
+        atomic_fetch_add(&fit_files, 1);
+        parsed = true;
+    }
+    else if (use_fast_gpx_parser && gpxFast_parse_file(filename, track, buffer, &found_time))
+    {
+        atomic_fetch_add(&fast_path_files, 1);
+        parsed = true;
+    }
+    else
+    {
+        // start over, the fast path may have stopped halfway through the file
+        gpxParser_reset_track(track);
+        found_time = false;
+        atomic_fetch_add(&fallback_files, 1);
+        parsed = gpxParser_read_with_libxml(filename, track, buffer, &found_time);
     }
 
-    // Free resources
-    xmlFreeDoc(doc);
-    xmlCleanupParser();
+    if (!parsed)
+    {
+        fprintf(stderr, "Failed to parse %s\n", filename);
+        return false;
+    }
+
+    gpxParser_finish_track(filename, track, found_time);
     return true;
 }
 
-int gpxParser_count_gpx_files(){
-    const char *folder_path = "./gpx_files"; // Folder containing GPX files
-    DIR *dir;
-    struct dirent *entry;
+// Same as gpxParser_parse_file for a track that was decompressed into memory
+bool gpxParser_parse_buffer(const char *name, const char *data, size_t length, GpxTrack *track, PointBuffer *buffer)
+{
+    gpxParser_reset_track(track);
+
+    bool found_time = false;
+    bool parsed = false;
+    if (gpxParser_is_fit_file(name))
+    {
+        if (!fitParser_parse_buffer((const uint8_t *)data, length, track, buffer, &found_time))
+        {
+            printf("Skipping %s (no GPS points, unsupported sport or damaged file)\n", name);
+            return false;
+        }
+        atomic_fetch_add(&fit_files, 1);
+        parsed = true;
+    }
+    else if (use_fast_gpx_parser && gpxFast_parse_buffer(data, length, track, buffer, &found_time))
+    {
+        atomic_fetch_add(&fast_path_files, 1);
+        parsed = true;
+    }
+    else
+    {
+        gpxParser_reset_track(track);
+        found_time = false;
+        atomic_fetch_add(&fallback_files, 1);
+        parsed = gpxParser_read_memory_with_libxml(name, data, length, track, buffer, &found_time);
+    }
 
-    dir = opendir(folder_path);
+    if (!parsed)
+    {
+        fprintf(stderr, "Failed to parse %s\n", name);
+        return false;
+    }
+
+    gpxParser_finish_track(name, track, found_time);
+    return true;
+}
+
+static bool gpxParser_is_gpx_file(const char *name)
+{
+    // Skip "." and ".."
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return false;
+
+    // only read .gpx and .fit files, plain, gzipped or inside zip archives
+    return strstr(name, ".gpx") != NULL || gpxParser_is_fit_file(name) || archive_is_zip(name);
+}
+
+// Zip members are imported if they are gpx or fit files, nested archives are not opened
+static bool gpxParser_is_track_member(const char *member)
+{
+    if (archive_is_gzip(member))
+        return false;
+    return strstr(member, ".gpx") != NULL || gpxParser_is_fit_file(member);
+}
+
+static bool gpxParser_add_source(IngestSourceList *list, const char *name, int archive, const ArchiveEntry *entry)
+{
+    if (list->count >= list->capacity)
+    {
+        int new_capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        IngestSource *temp = (IngestSource *)realloc(list->sources, new_capacity * sizeof(IngestSource));
+        if (!temp)
+        {
+            perror("realloc");
+            return false;
+        }
+        list->sources = temp;
+        list->capacity = new_capacity;
+    }
+
+    IngestSource *source = &list->sources[list->count];
+    source->name = strdup(name);
+    if (!source->name)
+        return false;
+    source->archive = archive;
+    if (entry)
+        source->entry = *entry;
+    else
+        memset(&source->entry, 0, sizeof(source->entry));
+    list->count++;
+    return true;
+}
+
+static bool gpxParser_add_zip_member(void *context, const char *member, const ArchiveEntry *entry)
+{
+    IngestSourceList *list = (IngestSourceList *)context;
+    if (!gpxParser_is_track_member(member))
+        return true;
+
+    char name[1024];
+    snprintf(name, sizeof(name), "%s/%s", list->archives[list->archive_count - 1].file_name, member);
+    return gpxParser_add_source(list, name, list->archive_count - 1, entry);
+}
+
+static bool gpxParser_add_zip_archive(IngestSourceList *list, const char *folder_path, const char *file_name)
+{
+    ZipArchive *temp = (ZipArchive *)realloc(list->archives, (list->archive_count + 1) * sizeof(ZipArchive));
+    if (!temp)
+    {
+        perror("realloc");
+        return false;
+    }
+    list->archives = temp;
+
+    char full_path[1024];
+    snprintf(full_path, sizeof(full_path), "%s/%s", folder_path, file_name);
+
+    ZipArchive *archive = &list->archives[list->archive_count];
+    archive->file_name = strdup(file_name);
+    if (!archive->file_name || !archive_map_zip(full_path, archive))
+    {
+        free(archive->file_name);
+        return false;
+    }
+    list->archive_count++;
+
+    // a damaged archive only loses the members after the damage
+    archive_list_zip(archive, gpxParser_add_zip_member, list);
+    return true;
+}
+
+static int compare_sources(const void *a, const void *b)
+{
+    return strcmp(((const IngestSource *)a)->name, ((const IngestSource *)b)->name);
+}
+
+// Collect all tracks of a folder including zip archive members, sorted so track ids do not depend on readdir order.
+// Zip archives stay mapped until gpxParser_free_sources.
+static bool gpxParser_list_sources(const char *folder_path, IngestSourceList *list)
+{
+    memset(list, 0, sizeof(*list));
+
+    DIR *dir = opendir(folder_path);
     if (dir == NULL)
     {
         perror("opendir");
         return false;
     }
-    int gpx_file_counter = 0;
+
+    struct dirent *entry;
     while ((entry = readdir(dir)) != NULL)
     {
-        // Skip "." and ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        if (!gpxParser_is_gpx_file(entry->d_name))
             continue;
 
-        // only read .gpx files
-        if (strstr(entry->d_name, ".gpx") == NULL)
-            continue;
+        if (archive_is_zip(entry->d_name))
+            gpxParser_add_zip_archive(list, folder_path, entry->d_name);
+        else if (!gpxParser_add_source(list, entry->d_name, -1, NULL))
+            break;
+    }
+    closedir(dir);
+
+    qsort(list->sources, list->count, sizeof(IngestSource), compare_sources);
+    return true;
+}
 
-        gpx_file_counter++;
+static void gpxParser_free_sources(IngestSourceList *list)
+{
+    for (int i = 0; i < list->count; i++)
+        free(list->sources[i].name);
+    free(list->sources);
+    for (int i = 0; i < list->archive_count; i++)
+    {
+        archive_unmap_zip(&list->archives[i]);
+        free(list->archives[i].file_name);
     }
+    free(list->archives);
+    memset(list, 0, sizeof(*list));
+}
 
+int gpxParser_count_gpx_files(){
+    IngestSourceList list;
+    if (!gpxParser_list_sources(GPX_FOLDER, &list))
+        return 0;
+
+    int gpx_file_counter = list.count;
     printf("Found gpx files: %d\n", gpx_file_counter);
 
-    closedir(dir);
+    gpxParser_free_sources(&list);
     return gpx_file_counter;
 
 }
 
-bool gpxParser_parse_all_files(GpxCollection *collection)
+// Parse one import source, decompressing it into the reusable buffer first if needed
+static bool gpxParser_parse_source(const char *folder_path, const IngestSource *source, const ZipArchive *archives,
+                                   GpxTrack *track, PointBuffer *scratch, ByteBuffer *decompressed)
 {
-    const char *folder_path = "./gpx_files"; // Folder containing GPX files
-    DIR *dir;
-    struct dirent *entry;
+    char full_path[1024];
+    snprintf(full_path, sizeof(full_path), "%s/%s", folder_path, source->name);
 
-    dir = opendir(folder_path);
-    if (dir == NULL)
+    if (source->archive >= 0)
     {
-        perror("opendir");
-        return false;
+        if (!archive_read_zip_entry(&archives[source->archive], &source->entry, decompressed))
+        {
+            fprintf(stderr, "Failed to extract %s\n", full_path);
+            return false;
+        }
+        return gpxParser_parse_buffer(full_path, (const char *)decompressed->data, decompressed->size, track, scratch);
+    }
+    if (archive_is_gzip(source->name))
+    {
+        return archive_read_gzip(full_path, decompressed) &&
+               gpxParser_parse_buffer(full_path, (const char *)decompressed->data, decompressed->size, track, scratch);
+    }
+    return gpxParser_parse_file(full_path, track, scratch);
+}
+
+// Size and modification time the track cache uses to decide whether a source changed
+static bool gpxParser_identify_source(const char *folder_path, const IngestSource *source, GpxTrack *track)
+{
+    strncpy(track->source_name, source->name, sizeof(track->source_name) - 1);
+
+    if (source->archive >= 0)
+    {
+        // zip members are identified by their content, a re-exported archive keeps its cache entries
+        track->source_size = (int64_t)source->entry.uncompressed_size;
+        track->source_mtime = source->entry.crc;
+        return true;
     }
 
+    char full_path[1024];
+    snprintf(full_path, sizeof(full_path), "%s/%s", folder_path, source->name);
+    return trackCache_stat_source(full_path, &track->source_size, &track->source_mtime);
+}
+
+void *gpxParser_ingest_worker(void *arg)
+{
+    IngestTask *task = (IngestTask *)arg;
+    trace_set_thread_name("import worker");
+
+    // every file of this worker is parsed into the same scratch buffer, encoded into a second one
+    // and then copied to the arena, compressed files are inflated into a third reusable buffer first
+    PointBuffer scratch = {0};
+    ByteBuffer encoded = {0};
+    ByteBuffer decompressed = {0};
+
+    while (true)
+    {
+        pthread_mutex_lock(task->next_file_mutex);
+        int file = (*task->next_file)++;
+        pthread_mutex_unlock(task->next_file_mutex);
+
+        if (file >= task->total_files)
+            break;
+        if (task->progress && atomic_load(&task->progress->cancel))
+            break;
+
+        // already restored from the track cache, or known to yield no track
+        if (task->parsed[file] || task->skipped[file])
+            continue;
+
+        GpxTrack *current = &task->tracks[file];
+        current->track_id = file;
+        current->points = NULL;
+        current->total_points = 0;
+
+        uint64_t trace_start_ns = trace_begin();
+        bool parsed = gpxParser_parse_source(task->folder_path, &task->sources[file], task->archives, current, &scratch, &decompressed);
+        trace_end("parse file", task->sources[file].name, trace_start_ns);
+        if (task->progress)
+            atomic_fetch_add(&task->progress->done, 1);
+        if (!parsed)
+        {
+            // remembered in the track cache so an unchanged file is not read again on the next start
+            task->skipped[file] = true;
+            continue;
+        }
+        if (!byteBuffer_reserve(&encoded, POINT_ENCODED_BOUND(current->total_points)))
+            continue;
+
+        size_t size = pointArena_encode(current->points, current->total_points, encoded.data);
+        pthread_mutex_lock(task->arena_mutex);
+        task->parsed[file] = pointArena_append_encoded(task->arena, encoded.data, size, current->total_points, current);
+        pthread_mutex_unlock(task->arena_mutex);
+        current->points = NULL;
+    }
+
+    pointBuffer_free(&scratch);
+    byteBuffer_free(&encoded);
+    byteBuffer_free(&decompressed);
+    return NULL;
+}
+
+static int gpxParser_worker_count(int total_files)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cpus > 0 ? (int)cpus : 1;
+    if (workers > total_files)
+        workers = total_files;
+    return workers < 1 ? 1 : workers;
+}
+
+// Import every track of folder_path. cache_path may be NULL to parse everything without the track cache,
+// progress may be NULL, otherwise it counts the files done and progress->cancel stops the import
+bool gpxParser_parse_all_files(GpxCollection *collection, const char *folder_path, const char *cache_path, LoadProgress *progress)
+{
+    TRACE_SCOPE("import");
     collection->total_tracks = 0;
     collection->tracks = NULL;
+    pointArena_free(&collection->point_arena);
+    trackPyramid_free(&collection->pyramid);
+    free(collection->list_order);
+    collection->list_order = NULL;
 
-    while ((entry = readdir(dir)) != NULL)
+    IngestSourceList sources;
+    if (!gpxParser_list_sources(folder_path, &sources))
+        return false;
+    int total_files = sources.count;
+
+    // one slot per file, filled by the workers in any order
+    GpxTrack *tracks = (GpxTrack *)calloc(total_files > 0 ? total_files : 1, sizeof(GpxTrack));
+    bool *parsed = (bool *)calloc(total_files > 0 ? total_files : 1, sizeof(bool));
+    bool *skipped = (bool *)calloc(total_files > 0 ? total_files : 1, sizeof(bool));
+    if (!tracks || !parsed || !skipped)
+    {
+        perror("calloc");
+        free(tracks);
+        free(parsed);
+        free(skipped);
+        gpxParser_free_sources(&sources);
+        return false;
+    }
+
+    // restore every file that did not change since the last run from the track cache
+    TrackCache cache;
+    if (cache_path)
+        trackCache_open(&cache, cache_path);
+    else
+        memset(&cache, 0, sizeof(cache));
+    int cached_files = 0;
+    int cached_skipped = 0;
+    for (int i = 0; i < total_files; i++)
     {
-        // Skip "." and ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        GpxTrack *current = &tracks[i];
+        if (!gpxParser_identify_source(folder_path, &sources.sources[i], current))
+        {
+            // without size and modification time the file cannot be cached, not even as skipped
+            current->source_size = -1;
             continue;
+        }
 
-        // only read .gpx files
-        if (strstr(entry->d_name, ".gpx") == NULL)
+        bool cache_skipped;
+        if (!trackCache_lookup(&cache, current->source_name, current->source_size, current->source_mtime, current, &collection->point_arena, &cache_skipped))
             continue;
+        if (cache_skipped)
+        {
+            skipped[i] = true;
+            cached_skipped++;
+        }
+        else
+        {
+            parsed[i] = true;
+            cached_files++;
+        }
+    }
+    int cache_entries = (int)cache.entry_count;
+    trackCache_close(&cache);
 
-        // Reallocate track array for new file
-        collection->tracks = (GpxTrack *)realloc(
-            collection->tracks,
-            (collection->total_tracks + 1) * sizeof(GpxTrack));
+    if (progress)
+    {
+        atomic_store(&progress->total, total_files);
+        atomic_store(&progress->done, cached_files + cached_skipped);
+    }
 
-        if (!collection->tracks)
+    atomic_store(&fast_path_files, 0);
+    atomic_store(&fit_files, 0);
+    atomic_store(&fallback_files, 0);
+    int restored = cached_files + cached_skipped;
+    int num_workers = gpxParser_worker_count(total_files - restored);
+    printf("Parsing %d files in %d threads, %d restored from cache, %d skipped as before\n", total_files - restored, num_workers, cached_files, cached_skipped);
+
+    pthread_t threads[num_workers];
+    IngestTask task = {
+        .folder_path = folder_path,
+        .sources = sources.sources,
+        .total_files = total_files,
+        .archives = sources.archives,
+        .tracks = tracks,
+        .parsed = parsed,
+        .skipped = skipped,
+    };
+    pthread_mutex_t next_file_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+    int next_file = 0;
+    task.next_file = &next_file;
+    task.next_file_mutex = &next_file_mutex;
+    task.arena = &collection->point_arena;
+    task.arena_mutex = &arena_mutex;
+    task.progress = progress;
+
+    int started = 0;
+    for (int t = 0; t < num_workers; t++)
+    {
+        if (pthread_create(&threads[t], NULL, gpxParser_ingest_worker, &task) != 0)
         {
-            perror("realloc");
-            closedir(dir);
-            return false;
+            perror("pthread_create failed");
+            break;
         }
+        started++;
+    }
+    // without any worker the main thread does the job itself
+    if (started == 0)
+        gpxParser_ingest_worker(&task);
 
-        // Construct full path
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s", folder_path, entry->d_name);
-        GpxTrack *current = &collection->tracks[collection->total_tracks];
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    printf("Parser paths: %d files via fast path, %d files via libxml2, %d FIT files\n", atomic_load(&fast_path_files), atomic_load(&fallback_files), atomic_load(&fit_files));
 
-        // Parse file and fill current track
-        current->track_id = collection->total_tracks;
-        current->points = NULL;
-        current->total_points = 0;
+    // stopped at exit: the points already in the arena are released by the caller, the cache stays as it is
+    if (progress && atomic_load(&progress->cancel))
+    {
+        printf("Import cancelled\n");
+        free(tracks);
+        free(parsed);
+        free(skipped);
+        gpxParser_free_sources(&sources);
+        return false;
+    }
+
+    // the sources that yielded no track go into the cache as well, collect them before the slots are compacted
+    int total_skipped = 0;
+    GpxTrack *skipped_sources = NULL;
+    if (cache_path)
+    {
+        skipped_sources = (GpxTrack *)calloc(total_files > 0 ? total_files : 1, sizeof(GpxTrack));
+        if (!skipped_sources)
+            perror("calloc");
+        for (int i = 0; skipped_sources && i < total_files; i++)
+        {
+            if (!skipped[i] || tracks[i].source_size < 0)
+                continue;
+            GpxTrack *current = &skipped_sources[total_skipped++];
+            memcpy(current->source_name, tracks[i].source_name, sizeof(current->source_name));
+            current->source_size = tracks[i].source_size;
+            current->source_mtime = tracks[i].source_mtime;
+        }
+    }
 
-        // Call your GPX parsing function here
-        gpxParser_parse_file(full_path, current);
-        printf("Tracks %d has %d data points\n", collection->total_tracks, collection->tracks[collection->total_tracks].total_points);
+    // compact the slots in file name order, dropping files that failed to parse
+    for (int i = 0; i < total_files; i++)
+    {
+        if (!parsed[i])
+            continue;
+        GpxTrack *current = &tracks[collection->total_tracks];
+        if (current != &tracks[i])
+            *current = tracks[i];
+        current->track_id = collection->total_tracks;
         collection->total_tracks++;
     }
+    collection->tracks = tracks;
+    collection->list_order = (int *)malloc((collection->total_tracks > 0 ? collection->total_tracks : 1) * sizeof(int));
+    if (!collection->list_order)
+    {
+        perror("malloc");
+        free(skipped_sources);
+        free(parsed);
+        free(skipped);
+        gpxParser_free_sources(&sources);
+        return false;
+    }
+    pointArena_bind_tracks(&collection->point_arena, collection->tracks, collection->total_tracks);
+    printf("Point arena holds %zu points\n", collection->point_arena.count);
+    trackPyramid_build_all(&collection->pyramid, collection->tracks, collection->total_tracks);
 
     for (int i = 0; i < collection->total_tracks; i++)
     {
@@ -537,6 +962,92 @@ bool gpxParser_parse_all_files(GpxCollection *collection)
     }
     printf("Tracks: %d\n", collection->total_tracks);
 
-    closedir(dir);
+    // rewrite the cache when files were added, changed or removed
+    if (cache_path && skipped_sources && (collection->total_tracks + total_skipped != restored || restored != cache_entries))
+        trackCache_write(cache_path, collection->tracks, collection->total_tracks, skipped_sources, total_skipped);
+
+    free(skipped_sources);
+    free(parsed);
+    free(skipped);
+    gpxParser_free_sources(&sources);
     return true;
 }
+
+// Parse one entry of the gpx folder outside of the full import: a track file or all members of a zip archive.
+// Every returned track owns its points, release them with gpxParser_free_parsed_tracks.
+int gpxParser_parse_folder_entry(const char *folder_path, const char *file_name, GpxTrack **tracks)
+{
+    *tracks = NULL;
+    if (!gpxParser_is_gpx_file(file_name))
+        return 0;
+
+    IngestSourceList list;
+    memset(&list, 0, sizeof(list));
+    if (archive_is_zip(file_name))
+    {
+        if (!gpxParser_add_zip_archive(&list, folder_path, file_name))
+            return 0;
+        qsort(list.sources, list.count, sizeof(IngestSource), compare_sources);
+    }
+    else if (!gpxParser_add_source(&list, file_name, -1, NULL))
+    {
+        return 0;
+    }
+
+    GpxTrack *parsed = (GpxTrack *)calloc(list.count > 0 ? list.count : 1, sizeof(GpxTrack));
+    if (!parsed)
+    {
+        perror("calloc");
+        gpxParser_free_sources(&list);
+        return 0;
+    }
+
+    PointBuffer scratch = {0};
+    ByteBuffer decompressed = {0};
+    int count = 0;
+    for (int i = 0; i < list.count; i++)
+    {
+        GpxTrack *current = &parsed[count];
+        if (!gpxParser_identify_source(folder_path, &list.sources[i], current))
+            continue;
+        if (!gpxParser_parse_source(folder_path, &list.sources[i], list.archives, current, &scratch, &decompressed))
+            continue;
+
+        GpxPoint *points = (GpxPoint *)malloc((current->total_points > 0 ? current->total_points : 1) * sizeof(GpxPoint));
+        if (!points)
+        {
+            perror("malloc");
+            continue;
+        }
+        memcpy(points, current->points, current->total_points * sizeof(GpxPoint));
+        current->points = points;
+        gpxTrack_calculate_strings_for_UI(current);
+        count++;
+    }
+
+    pointBuffer_free(&scratch);
+    byteBuffer_free(&decompressed);
+    gpxParser_free_sources(&list);
+    *tracks = parsed;
+    return count;
+}
+
+void gpxParser_free_parsed_tracks(GpxTrack *tracks, int total_tracks)
+{
+    for (int i = 0; i < total_tracks; i++)
+        free(tracks[i].points);
+    free(tracks);
+}
+
+// libxml2 keeps global state: set it up once from the main thread before the import, the
+// watcher or any other thread can parse, gpxParser_cleanup tears it down at exit
+void gpxParser_init(void)
+{
+    LIBXML_TEST_VERSION
+    xmlInitParser();
+}
+
+void gpxParser_cleanup(void)
+{
+    xmlCleanupParser();
+}
@@ -5,17 +5,37 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <string.h>
+#include <strings.h>
 #include <math.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include "structs.h"
 #include "map.h"
+#include "trackcache.h"
+#include "gpxFastParser.h"
+#include "fastparse.h"
+#include "pointarena.h"
+#include "fitParser.h"
+#include "archive.h"
+#include "pyramid.h"
+#include "trace.h"
 
 #define EARTH_RADIUS_METERS 6371000.0
+#define GPX_FOLDER "./gpx_files"
 
 
-bool gpxParser_parse_all_files(GpxCollection *collection);
+void latLonToPixel(double lat, double lon, int zoom, int *x, int *y);
+void pixelToLatLon(int x, int y, int zoom, double *lat, double *lon);
+bool gpxParser_parse_all_files(GpxCollection *collection, const char *folder_path, const char *cache_path, LoadProgress *progress);
 int gpxParser_count_gpx_files();
+int gpxParser_parse_folder_entry(const char *folder_path, const char *file_name, GpxTrack **tracks);
+void gpxParser_free_parsed_tracks(GpxTrack *tracks, int total_tracks);
+void gpxParser_init(void);
+void gpxParser_cleanup(void);
 
 #endif
\ No newline at end of file
@@ -1,63 +1,19 @@
 #include "heat.h"
 
-// Globale Variable für Sortierachse
-int current_axis;
+extern HeatIndex heat_index;
+extern int heat_threads;
 
-// Vergleichsfunktion für qsort
-int compare_points(const void *a, const void *b)
+static inline double squared_distance_xy(int x1, int y1, int x2, int y2, float mercator_x_correction)
 {
-    GpxPoint *p1 = *(GpxPoint **)a;
-    GpxPoint *p2 = *(GpxPoint **)b;
-    double diff = (current_axis == 0) ? (p1->world_x - p2->world_x) : (p1->world_y - p2->world_y);
-    return (diff > 0) - (diff < 0);
-}
-
-// Erstelle einen neuen Knoten
-KDNode *create_node(GpxPoint *point, int axis)
-{
-    KDNode *node = (KDNode *)malloc(sizeof(KDNode));
-    if (!node)
-    {
-        perror("malloc failed");
-        exit(EXIT_FAILURE);
-    }
-    node->point = point;
-    node->axis = axis;
-    node->left = node->right = NULL;
-    return node;
-}
-
-// Baue den k-d-Tree rekursiv
-KDNode *build_kdtree(GpxPoint **points, int n, int depth)
-{
-    if (n <= 0)
-        return NULL;
-    int axis = depth % 2;
-    current_axis = axis;
-    qsort(points, n, sizeof(GpxPoint *), compare_points);
-    int median = n / 2;
-    KDNode *node = create_node(points[median], axis);
-    node->left = build_kdtree(points, median, depth + 1);
-    node->right = build_kdtree(points + median + 1, n - median - 1, depth + 1);
-    return node;
-}
-
-void free_kdtree(KDNode *node)
-{
-    if (node == NULL)
-        return;
-
-    free_kdtree(node->left);
-    free_kdtree(node->right);
-    free(node); // Nur der KDNode selbst, nicht node->point!
+    // einfache flache projektion
+    long int dx = (x2 - x1) * mercator_x_correction;
+    long int dy = (y2 - y1);
+    return dx * dx + dy * dy;
 }
 
 double squared_distance(GpxPoint p1, GpxPoint p2, float mercator_x_correction)
 {
-    // einfache flache projektion
-    long int dx = (p2.world_x - p1.world_x) * mercator_x_correction;
-    long int dy = (p2.world_y - p1.world_y);
-    return dx * dx + dy * dy;
+    return squared_distance_xy(p1.world_x, p1.world_y, p2.world_x, p2.world_y, mercator_x_correction);
 }
 
 float get_x_correction_factor(int world_y)
@@ -83,44 +39,50 @@ float get_x_correction_factor(int world_y)
         return 0.09;
 }
 
-// Radius-Suche
-void radius_search(KDNode *node, GpxPoint *target, double radius2, int *count, int *checked_ids, int total_tracks, float x_correction)
+// Tracks already counted for the current point: a track is counted when its entry in last_seen
+// differs from epoch. Every point takes the next epoch, so nothing has to be cleared between them.
+typedef struct
 {
-    if (!node)
-        return;
-    if (node->point->track_id != target->track_id && squared_distance(*node->point, *target, x_correction) <= radius2)
-    {
-        bool idAlreadyChecked = false;
-        for (int i = 0; i < *count; i++)
-        {
-            if (node->point->track_id == checked_ids[i])
-            {
-                idAlreadyChecked = true;
-                break;
-            }
-        }
-        if (!idAlreadyChecked && *count < total_tracks)
-        {
-            checked_ids[*count] = node->point->track_id;
-            (*count)++;
-        }
-    }
-    int axis = node->axis;
-    float diff = (axis == 0) ? target->world_x - node->point->world_x : target->world_y - node->point->world_y;
-    if (diff <= 0)
+    uint32_t *last_seen; // per track id
+    uint32_t epoch;
+    int total_tracks;
+} TrackCounter;
+
+static bool trackCounter_init(TrackCounter *counter, int total_tracks)
+{
+    counter->last_seen = (uint32_t *)calloc(total_tracks > 0 ? total_tracks : 1, sizeof(uint32_t));
+    counter->epoch = 0;
+    counter->total_tracks = total_tracks;
+    return counter->last_seen != NULL;
+}
+
+static void trackCounter_next_point(TrackCounter *counter)
+{
+    counter->epoch++;
+    if (counter->epoch == 0)
     {
-        radius_search(node->left, target, radius2, count, checked_ids, total_tracks, x_correction);
-        if (diff * diff <= radius2)
-            radius_search(node->right, target, radius2, count, checked_ids, total_tracks, x_correction);
+        // wrapped around after 2^32 points, old stamps could match again
+        memset(counter->last_seen, 0, counter->total_tracks * sizeof(uint32_t));
+        counter->epoch = 1;
     }
-    else
+}
+
+// Count a track that is in range once per point
+static inline void trackCounter_add(TrackCounter *counter, int track_id, int *count)
+{
+    if (counter->last_seen[track_id] != counter->epoch)
     {
-        radius_search(node->right, target, radius2, count, checked_ids, total_tracks, x_correction);
-        if (diff * diff <= radius2)
-            radius_search(node->left, target, radius2, count, checked_ids, total_tracks, x_correction);
+        counter->last_seen[track_id] = counter->epoch;
+        (*count)++;
     }
 }
 
+static void trackCounter_free(TrackCounter *counter)
+{
+    free(counter->last_seen);
+    counter->last_seen = NULL;
+}
+
 void print_progress_bar(int current, int total, int bar_width, struct timespec *start_time)
 {
     struct timespec current_time;
@@ -149,152 +111,733 @@ void print_progress_bar(int current, int total, int bar_width, struct timespec *
     fflush(stdout);
 }
 
-void *heatmap_worker(void *arg)
+// State a worker keeps to itself while it runs, only merged when it is done
+typedef struct
 {
-    HeatmapTask *task = (HeatmapTask *)arg;
+    TrackCounter counter;
+    int max_heat;
+    int progress; // points not yet added to total_progress
+    int slot;     // next entry of completed reserved for this worker
+} HeatWorker;
 
-    int progress_update_increments = 100;
+static inline void heat_store(HeatmapTask *task, HeatWorker *worker, int point, int count)
+{
+    atomic_store_explicit(&task->heat[point], count, memory_order_relaxed);
+    // the heat is stored before the point shows up in the completed log
+    if (task->completed)
+        atomic_store_explicit(&task->completed[worker->slot++], point, memory_order_release);
+    if (count > worker->max_heat)
+        worker->max_heat = count;
+    worker->progress++;
+}
 
-    int *checked_ids = (int *)malloc(task->total_tracks * sizeof(int));
-    if (!checked_ids)
-    {
-        fprintf(stderr, "Thread malloc failed\n");
-        return NULL;
-    }
+// Heat of the points of one grid cell, the neighbours of all of them are in the same three
+// ranges of the rows above, at and below the cell
+static void heat_grid_cell(HeatmapTask *task, int cell, HeatWorker *worker)
+{
+    const HeatGrid *grid = task->grid;
+    uint64_t key = grid->cells[cell].key;
+    int cell_x = (int)(uint32_t)key;
+    int cell_y = (int)(key >> 32);
+    int first[3], end[3];
+    for (int r = 0; r < 3; r++)
+        heatGrid_row_range(grid, cell_x, cell_y - 1 + r, &first[r], &end[r]);
 
-    for (int i = task->start; i < task->end; i++)
+    for (int i = grid->cells[cell].first; i < grid->cells[cell + 1].first; i++)
     {
-        float x_correction = get_x_correction_factor(task->points[i]->world_y);
-        // search for points in range
+        const HeatSample *target = &grid->points[i];
+        float x_correction = get_x_correction_factor(target->world_y);
         int count = 0;
-        memset(checked_ids, -1, task->total_tracks * sizeof(int));
-        radius_search(task->tree, task->points[i], task->radius2, &count, checked_ids, task->total_tracks, x_correction);
-        task->points[i]->heat = count;
-
-        pthread_mutex_lock(task->max_mutex);
-        if (count > *(task->thread_max_heat))
-        {
-            *(task->thread_max_heat) = count;
-        }
-        pthread_mutex_unlock(task->max_mutex);
-
-        task->thread_progress++;
-        if (task->thread_progress >= progress_update_increments)
+        trackCounter_next_point(&worker->counter);
+        for (int r = 0; r < 3; r++)
         {
-            pthread_mutex_lock(task->progress_mutex);
-            *(task->total_progress) += task->thread_progress;
-            task->thread_progress = 0;
-            pthread_mutex_unlock(task->progress_mutex);
+            for (int j = first[r]; j < end[r]; j++)
+            {
+                const HeatSample *other = &grid->points[j];
+                if (other->track_id != target->track_id &&
+                    squared_distance_xy(other->world_x, other->world_y, target->world_x, target->world_y, x_correction) <= task->radius2)
+                    trackCounter_add(&worker->counter, other->track_id, &count);
+            }
         }
+        heat_store(task, worker, target->point, count);
     }
-    free(checked_ids);
-    pthread_mutex_lock(task->progress_mutex);
-    *(task->total_progress) += task->thread_progress;
-    task->thread_progress = 0;
-    pthread_mutex_unlock(task->progress_mutex);
-    return NULL;
 }
 
-bool calculate_heatmap(GpxCollection *collection)
+// Heat of one point of the kd-tree. The box is as wide as the x correction of the point allows,
+// so the tree only prunes what squared_distance would reject.
+static void heat_kdtree_point(HeatmapTask *task, int i, HeatWorker *worker)
 {
-    // convert gpx track collection a single big point collection
-    int total_points = 0;
-    for (int i = 0; i < collection->total_tracks; i++)
+    const HeatSample *target = &task->tree->points[i];
+    float x_correction = get_x_correction_factor(target->world_y);
+    int64_t reach_x = (int64_t)((HEAT_RADIUS + 1.0f) / x_correction) + 1;
+    int64_t reach_y = (int64_t)HEAT_RADIUS;
+    KdQuery query;
+    kdQuery_init(&query, task->tree, (int64_t)target->world_x - reach_x, (int64_t)target->world_y - reach_y,
+                 (int64_t)target->world_x + reach_x, (int64_t)target->world_y + reach_y);
+    int count = 0;
+    trackCounter_next_point(&worker->counter);
+    while (kdQuery_next(&query))
     {
-        if (collection->tracks[i].visible_in_list == true)
-        {
-            total_points = total_points + collection->tracks[i].total_points;
-            printf("%d points in track %d\n", collection->tracks[i].total_points, i);
-        }
+        const HeatSample *other = &task->tree->points[query.index];
+        if (other->track_id != target->track_id &&
+            squared_distance_xy(other->world_x, other->world_y, target->world_x, target->world_y, x_correction) <= task->radius2)
+            trackCounter_add(&worker->counter, other->track_id, &count);
     }
-    printf("There are %d data points in total\n", total_points);
-    printf("Collecting all points in one array\n");
-    GpxPoint **points = (GpxPoint **)malloc(total_points * sizeof(GpxPoint *));
-    if (!points)
+    heat_store(task, worker, target->point, count);
+}
+
+static void heatmap_worker_done(HeatmapTask *task)
+{
+    pthread_mutex_lock(task->done_mutex);
+    (*task->running_workers)--;
+    pthread_cond_signal(task->done_cond);
+    pthread_mutex_unlock(task->done_mutex);
+}
+
+void *heatmap_worker(void *arg)
+{
+    HeatmapTask *task = (HeatmapTask *)arg;
+    trace_set_thread_name("heat worker");
+    uint64_t trace_start_ns = trace_begin();
+
+    HeatWorker worker = {0};
+    if (!trackCounter_init(&worker.counter, task->total_tracks))
     {
-        perror("malloc failed");
-        return false;
+        // the other workers take its batches
+        fprintf(stderr, "Thread malloc failed\n");
+        heatmap_worker_done(task);
+        return NULL;
     }
-    int i = 0;
-    for (int track_id = 0; track_id < collection->total_tracks; track_id++)
+
+    // small batches from a shared counter, so dense areas do not leave one worker behind
+    int batches = 0;
+    int start;
+    while ((start = atomic_fetch_add_explicit(task->next_item, task->batch_size, memory_order_relaxed)) < task->total_items)
     {
-        if (collection->tracks[track_id].visible_in_list == true)
+        if (task->cancel && atomic_load_explicit(task->cancel, memory_order_relaxed))
+            break;
+        int end = start + task->batch_size < task->total_items ? start + task->batch_size : task->total_items;
+        if (task->completed)
         {
-            for (int point_id = 0; point_id < collection->tracks[track_id].total_points; point_id++)
-            {
-                points[i] = &collection->tracks[track_id].points[point_id];
-                i++;
-            }
+            int batch_points = task->grid ? task->grid->cells[end].first - task->grid->cells[start].first : end - start;
+            worker.slot = atomic_fetch_add_explicit(task->completed_tail, batch_points, memory_order_relaxed);
+        }
+        for (int i = start; i < end; i++)
+        {
+            if (task->grid)
+                heat_grid_cell(task, i, &worker);
+            else
+                heat_kdtree_point(task, i, &worker);
         }
+        atomic_fetch_add_explicit(task->total_progress, worker.progress, memory_order_relaxed);
+        worker.progress = 0;
+        batches++;
     }
+    trackCounter_free(&worker.counter);
+    task->max_heat = worker.max_heat;
 
+    char detail[TRACE_DETAIL_LENGTH];
+    snprintf(detail, sizeof(detail), "%d batches of %d %s", batches, task->batch_size, task->grid ? "cells" : "points");
+    trace_end("heat worker", detail, trace_start_ns);
+    heatmap_worker_done(task);
+    return NULL;
+}
+
+// Threads of the heat calculation, -heatthreads or one per online CPU
+int heat_worker_count(void)
+{
+    if (heat_threads > 0)
+        return heat_threads;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Heat of every point: number of other tracks within HEAT_RADIUS. Results go to heat[],
+// the points are only read. If completed is set, the index of every point is appended to it
+// once its heat is stored. Returns the maximum heat or -1 on failure or when progress->cancel was set.
+static int heatmap_run(const PointColumns *points, int total_tracks, atomic_int *heat, atomic_int *completed, LoadProgress *progress)
+{
+    int total_points = points->count;
+    TRACE_SCOPE("heat");
     struct timespec start_time, end_time;
     clock_gettime(CLOCK_MONOTONIC, &start_time); // Startzeit messen
-    printf("Building kdtree\n");
-    float radius = 200.0f;
+    float radius = HEAT_RADIUS;
     float radius2 = radius * radius;
-    KDNode *tree = build_kdtree(points, total_points, 0);
 
-    printf("Calculating heat in %d threads\n", NUM_THREADS);
+    // the index sorts copies of the points, the columns and heat[] stay in their order
+    HeatGrid grid = {0};
+    KdTree tree = {0};
+    size_t index_bytes;
+    bool use_grid = heat_index == HEAT_INDEX_GRID;
+    uint64_t trace_start_ns = trace_begin();
+    if (use_grid)
+    {
+        printf("Building heat grid\n");
+        if (!heatGrid_build(&grid, points))
+            return -1;
+        trace_end("grid build", NULL, trace_start_ns);
+        index_bytes = heatGrid_bytes(&grid);
+    }
+    else
+    {
+        printf("Building kdtree\n");
+        if (!kdTree_build(&tree, points))
+            return -1;
+        trace_end("kd-tree build", NULL, trace_start_ns);
+        index_bytes = kdTree_bytes(&tree);
+    }
+    memstat_alloc(MEM_HEAT, index_bytes);
 
-    pthread_t threads[NUM_THREADS];
-    HeatmapTask tasks[NUM_THREADS];
-    pthread_mutex_t max_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
-    int max_heat = 0;
+    int total_items = use_grid ? grid.cell_count : total_points;
+    int batch_size = HEAT_BATCH_POINTS;
+    if (use_grid && total_points > 0)
+    {
+        // cells differ in size, a batch holds the cells of about HEAT_BATCH_POINTS points
+        batch_size = (int)((int64_t)HEAT_BATCH_POINTS * grid.cell_count / total_points);
+        if (batch_size < 1)
+            batch_size = 1;
+    }
+    int total_threads = heat_worker_count();
+    int max_threads = (total_items + batch_size - 1) / batch_size;
+    if (total_threads > max_threads)
+        total_threads = max_threads > 0 ? max_threads : 1;
+    printf("Calculating heat in %d threads\n", total_threads);
 
-    int total_progress = 0;
-    int chunk_size = total_points / NUM_THREADS;
+    pthread_t *threads = (pthread_t *)malloc(total_threads * sizeof(pthread_t));
+    HeatmapTask *tasks = (HeatmapTask *)malloc(total_threads * sizeof(HeatmapTask));
+    if (!threads || !tasks)
+    {
+        perror("malloc failed");
+        free(threads);
+        free(tasks);
+        kdTree_free(&tree);
+        heatGrid_free(&grid);
+        memstat_free(MEM_HEAT, index_bytes);
+        return -1;
+    }
+    pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+    int running_workers = total_threads;
+    atomic_int total_progress = 0;
+    atomic_int next_item = 0;
+    atomic_int completed_tail = 0;
 
-    for (int t = 0; t < NUM_THREADS; t++)
+    for (int t = 0; t < total_threads; t++)
     {
         tasks[t].points = points;
-        tasks[t].start = t * chunk_size;
-        tasks[t].end = (t == NUM_THREADS - 1) ? total_points : (t + 1) * chunk_size;
-        tasks[t].tree = tree;
+        tasks[t].heat = heat;
+        tasks[t].next_item = &next_item;
+        tasks[t].total_items = total_items;
+        tasks[t].batch_size = batch_size;
+        tasks[t].tree = use_grid ? NULL : &tree;
+        tasks[t].grid = use_grid ? &grid : NULL;
         tasks[t].radius2 = radius2;
-        tasks[t].total_tracks = collection->total_tracks;
-        tasks[t].thread_max_heat = &max_heat;
-        tasks[t].max_mutex = &max_mutex;
-        tasks[t].progress_mutex = &progress_mutex;
-        tasks[t].thread_progress = 0;
+        tasks[t].total_tracks = total_tracks;
+        tasks[t].max_heat = 0;
         tasks[t].total_progress = &total_progress;
+        tasks[t].completed = completed;
+        tasks[t].completed_tail = &completed_tail;
+        tasks[t].cancel = progress ? &progress->cancel : NULL;
+        tasks[t].done_mutex = &done_mutex;
+        tasks[t].done_cond = &done_cond;
+        tasks[t].running_workers = &running_workers;
 
         if (pthread_create(&threads[t], NULL, heatmap_worker, &tasks[t]) != 0)
         {
             perror("pthread_create failed");
-            free_kdtree(tree);
-            free(points);
-            return false;
+            // the workers already running take over the batches of the missing ones
+            pthread_mutex_lock(&done_mutex);
+            running_workers -= total_threads - t;
+            pthread_mutex_unlock(&done_mutex);
+            total_threads = t;
+            break;
         }
     }
-    while (true)
+
+    // the workers signal when they are done, until then the progress is shown every 100 ms
+    pthread_mutex_lock(&done_mutex);
+    while (running_workers > 0)
     {
-        pthread_mutex_lock(&progress_mutex);
-        print_progress_bar(total_progress, total_points, 30, &start_time);
-        if (total_progress >= total_points)
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 100000000;
+        if (deadline.tv_nsec >= 1000000000)
         {
-            pthread_mutex_unlock(&progress_mutex);
-            break;
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
         }
-        pthread_mutex_unlock(&progress_mutex);
-        usleep(100000);
+        pthread_cond_timedwait(&done_cond, &done_mutex, &deadline);
+
+        int done = atomic_load_explicit(&total_progress, memory_order_relaxed);
+        print_progress_bar(done, total_points, 30, &start_time);
+        if (progress)
+            atomic_store(&progress->done, done);
     }
+    pthread_mutex_unlock(&done_mutex);
 
-    for (int t = 0; t < NUM_THREADS; t++)
+    int max_heat = 0;
+    for (int t = 0; t < total_threads; t++)
     {
         pthread_join(threads[t], NULL);
+        if (tasks[t].max_heat > max_heat)
+            max_heat = tasks[t].max_heat;
     }
+    free(threads);
+    free(tasks);
+    pthread_mutex_destroy(&done_mutex);
+    pthread_cond_destroy(&done_cond);
 
-    collection->max_heat = max_heat;
+    kdTree_free(&tree);
+    heatGrid_free(&grid);
+    memstat_free(MEM_HEAT, index_bytes);
+
+    if (progress && atomic_load(&progress->cancel))
+    {
+        printf("\nHeatmap calculation cancelled\n");
+        return -1;
+    }
 
-    free_kdtree(tree);
-    free(points);
+    // every worker failed before taking a batch
+    if (atomic_load(&total_progress) < total_points)
+    {
+        fprintf(stderr, "\nHeatmap calculation failed\n");
+        return -1;
+    }
     clock_gettime(CLOCK_MONOTONIC, &end_time);
 
     double elapsed = (end_time.tv_sec - start_time.tv_sec) +
                      (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
 
     printf("\nHeatmap calculation took %.3f seconds\n", elapsed);
+    return max_heat;
+}
+
+// Copy the positions of the heat samples of all visible tracks into columns, arena_index tells
+// where each one came from in the point arena
+static bool heat_collect_samples(GpxCollection *collection, PointColumns *columns, size_t **arena_index)
+{
+    int total_points = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        if (collection->tracks[t].visible_in_list)
+        {
+            int samples;
+            trackPyramid_heat_samples(&collection->pyramid, &collection->tracks[t], &samples);
+            total_points += samples;
+        }
+    }
+
+    *arena_index = (size_t *)malloc((total_points > 0 ? total_points : 1) * sizeof(size_t));
+    if (!*arena_index || !pointColumns_alloc(columns, total_points))
+    {
+        perror("malloc failed");
+        free(*arena_index);
+        *arena_index = NULL;
+        return false;
+    }
+
+    int i = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        GpxTrack *track = &collection->tracks[t];
+        if (!track->visible_in_list)
+            continue;
+        int samples;
+        const int *sample = trackPyramid_heat_samples(&collection->pyramid, track, &samples);
+        pointStream_positions(track, sample, samples, &columns->world_x[i], &columns->world_y[i]);
+        for (int k = 0; k < samples; k++, i++)
+        {
+            columns->track_id[i] = track->track_id;
+            (*arena_index)[i] = track->first_point + (sample ? sample[k] : k);
+        }
+    }
     return true;
-}
\ No newline at end of file
+}
+
+bool calculate_heatmap(GpxCollection *collection)
+{
+    // convert gpx track collection a single big point collection, only the heat samples take part
+    printf("Collecting all points in one array\n");
+    PointColumns points;
+    size_t *arena_index;
+    if (!heat_collect_samples(collection, &points, &arena_index))
+        return false;
+    printf("There are %d data points in total\n", points.count);
+
+    atomic_int *heat = (atomic_int *)malloc((points.count > 0 ? points.count : 1) * sizeof(atomic_int));
+    if (!heat)
+    {
+        perror("malloc failed");
+        pointColumns_free(&points);
+        free(arena_index);
+        return false;
+    }
+
+    int max_heat = heatmap_run(&points, collection->total_tracks, heat, NULL, NULL);
+    if (max_heat >= 0)
+    {
+        for (int i = 0; i < points.count; i++)
+            collection->point_arena.heat[arena_index[i]] = pointHeat_clamp(atomic_load_explicit(&heat[i], memory_order_relaxed));
+        for (int track_id = 0; track_id < collection->total_tracks; track_id++)
+        {
+            if (collection->tracks[track_id].visible_in_list == true)
+                trackPyramid_spread_heat(&collection->pyramid, &collection->tracks[track_id]);
+        }
+        collection->max_heat = max_heat;
+    }
+
+    free(heat);
+    pointColumns_free(&points);
+    free(arena_index);
+    return max_heat >= 0;
+}
+
+static void *heatJob_thread(void *arg)
+{
+    HeatJob *job = (HeatJob *)arg;
+    trace_set_thread_name("heat job");
+
+    job->max_heat = heatmap_run(&job->points, job->total_tracks, job->heat, job->completed, job->progress);
+    atomic_store(&job->finished, true);
+    return NULL;
+}
+
+static size_t heatJob_bytes(const HeatJob *job)
+{
+    size_t count = job->total_points > 0 ? job->total_points : 1;
+    size_t tracks = job->total_tracks > 0 ? job->total_tracks : 1;
+    return count * (3 * sizeof(int) + sizeof(size_t) + 2 * sizeof(atomic_int)) + tracks * (sizeof(bool) + sizeof(int));
+}
+
+static void heatJob_free(HeatJob *job)
+{
+    pointColumns_free(&job->points);
+    free(job->arena_index);
+    free(job->heat);
+    free(job->completed);
+    free(job->track_changed);
+    free(job->changed_tracks);
+    job->arena_index = NULL;
+    job->heat = NULL;
+    job->completed = NULL;
+    job->track_changed = NULL;
+    job->changed_tracks = NULL;
+}
+
+// Start the heat calculation of all visible tracks in the background. The collection is not
+// touched until heatJob_apply copies the results back, the points must not move until then.
+// Only the positions of the heat samples are snapshotted, heatJob_apply spreads their heat.
+bool heatJob_start(HeatJob *job, GpxCollection *collection, LoadProgress *progress)
+{
+    job->total_tracks = collection->total_tracks;
+    job->max_heat = 0;
+    job->seen_max_heat = 0;
+    job->applied = 0;
+    job->progress = progress;
+    atomic_store(&job->finished, false);
+    job->heat = NULL;
+    job->completed = NULL;
+    job->track_changed = NULL;
+    job->changed_tracks = NULL;
+    if (!heat_collect_samples(collection, &job->points, &job->arena_index))
+        return false;
+    job->total_points = job->points.count;
+
+    size_t count = job->total_points > 0 ? job->total_points : 1;
+    size_t tracks = job->total_tracks > 0 ? job->total_tracks : 1;
+    job->heat = (atomic_int *)malloc(count * sizeof(atomic_int));
+    job->completed = (atomic_int *)malloc(count * sizeof(atomic_int));
+    job->track_changed = (bool *)calloc(tracks, sizeof(bool));
+    job->changed_tracks = (int *)malloc(tracks * sizeof(int));
+    if (!job->heat || !job->completed || !job->track_changed || !job->changed_tracks)
+    {
+        perror("malloc failed");
+        heatJob_free(job);
+        return false;
+    }
+    for (int i = 0; i < job->total_points; i++)
+    {
+        atomic_init(&job->heat[i], -1);
+        atomic_init(&job->completed[i], -1);
+    }
+    memstat_alloc(MEM_HEAT, heatJob_bytes(job));
+
+    if (progress)
+    {
+        atomic_store(&progress->done, 0);
+        atomic_store(&progress->total, job->total_points);
+    }
+
+    if (pthread_create(&job->thread, NULL, heatJob_thread, job) != 0)
+    {
+        perror("pthread_create failed");
+        memstat_free(MEM_HEAT, heatJob_bytes(job));
+        heatJob_free(job);
+        return false;
+    }
+    return true;
+}
+
+// Copy the heat values finished since the last call back to the collection and redraw the
+// tiles of the tracks they belong to. Returns true once the job is finished, its memory is
+// released then.
+bool heatJob_apply(HeatJob *job, GpxCollection *collection)
+{
+    if (!job->heat)
+        return true;
+
+    bool finished = atomic_load(&job->finished);
+
+    // the workers log every sample they finish, everything before the first gap can be copied
+    int changed_count = 0;
+    while (job->applied < job->total_points)
+    {
+        int i = atomic_load_explicit(&job->completed[job->applied], memory_order_acquire);
+        if (i < 0)
+            break;
+        job->applied++;
+        int heat = atomic_load_explicit(&job->heat[i], memory_order_relaxed);
+        collection->point_arena.heat[job->arena_index[i]] = pointHeat_clamp(heat);
+        if (heat > job->seen_max_heat)
+            job->seen_max_heat = heat;
+        int track_id = job->points.track_id[i];
+        if (track_id < job->total_tracks && !job->track_changed[track_id])
+        {
+            job->track_changed[track_id] = true;
+            job->changed_tracks[changed_count++] = track_id;
+        }
+    }
+    for (int k = 0; k < changed_count; k++)
+    {
+        job->track_changed[job->changed_tracks[k]] = false;
+        trackPyramid_spread_heat(&collection->pyramid, &collection->tracks[job->changed_tracks[k]]);
+    }
+
+    // colors are relative to the maximum heat. It only goes up while the job runs, and the
+    // tiles are only all drawn again when it grew by more than 1 / HEAT_RESCALE_STEP.
+    int max_heat = collection->max_heat;
+    if (finished && job->max_heat >= 0)
+        max_heat = job->max_heat;
+    else if (job->seen_max_heat > max_heat + max_heat / HEAT_RESCALE_STEP)
+        max_heat = job->seen_max_heat;
+
+    if (max_heat != collection->max_heat)
+    {
+        collection->max_heat = max_heat;
+        free_track_tile_cache(&collection->track_tile_cache);
+    }
+    else
+    {
+        for (int k = 0; k < changed_count; k++)
+        {
+            const GpxTrack *track = &collection->tracks[job->changed_tracks[k]];
+            invalidate_track_tiles(&collection->track_tile_cache, track->min_x, track->min_y, track->max_x, track->max_y);
+        }
+    }
+
+    if (!finished)
+        return false;
+
+    pthread_join(job->thread, NULL);
+    memstat_free(MEM_HEAT, heatJob_bytes(job));
+    heatJob_free(job);
+    return true;
+}
+
+// Wait for a running job without copying its results, job->progress->cancel makes it stop early
+void heatJob_stop(HeatJob *job)
+{
+    if (!job->heat)
+        return;
+
+    pthread_join(job->thread, NULL);
+    memstat_free(MEM_HEAT, heatJob_bytes(job));
+    heatJob_free(job);
+}
+
+typedef struct
+{
+    uint64_t cell;
+    int point;
+} HeatCellEntry;
+
+static int compare_cell_entries(const void *a, const void *b)
+{
+    uint64_t c1 = ((const HeatCellEntry *)a)->cell;
+    uint64_t c2 = ((const HeatCellEntry *)b)->cell;
+    return (c1 > c2) - (c1 < c2);
+}
+
+// First entry of a cell in the sorted cell index, or count if the cell is empty
+static int find_cell(const HeatCellEntry *entries, int count, uint64_t cell)
+{
+    int low = 0, high = count;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (entries[mid].cell < cell)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return (low < count && entries[low].cell == cell) ? low : count;
+}
+
+// Add (delta = 1) or take back (delta = -1) the heat one track contributes to the points of all
+// other visible tracks, without rebuilding the whole heatmap. With delta = 1 the heat of the
+// track's own points is calculated as well. Gives the same result as calculate_heatmap.
+void update_heatmap_for_track(GpxCollection *collection, int track_id, int delta)
+{
+    GpxTrack *track = &collection->tracks[track_id];
+    if (!track->visible_in_list || track->total_points == 0)
+        return;
+
+    float radius2 = HEAT_RADIUS * HEAT_RADIUS;
+    int n;
+    const int *sample = trackPyramid_heat_samples(&collection->pyramid, track, &n);
+    if (n == 0)
+        return;
+
+    // sample positions of this track, and scratch space for those of every other track
+    int scratch_count = n;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        int other_n;
+        if (t != track_id && collection->tracks[t].visible_in_list)
+        {
+            trackPyramid_heat_samples(&collection->pyramid, &collection->tracks[t], &other_n);
+            if (other_n > scratch_count)
+                scratch_count = other_n;
+        }
+    }
+    int *track_x = (int *)malloc(n * sizeof(int));
+    int *track_y = (int *)malloc(n * sizeof(int));
+    int *other_x = (int *)malloc(scratch_count * sizeof(int));
+    int *other_y = (int *)malloc(scratch_count * sizeof(int));
+    HeatCellEntry *entries = (HeatCellEntry *)malloc(n * sizeof(HeatCellEntry));
+    int *last_track = (int *)malloc(n * sizeof(int));
+    if (!track_x || !track_y || !other_x || !other_y || !entries || !last_track)
+    {
+        perror("malloc failed");
+        free(track_x);
+        free(track_y);
+        free(other_x);
+        free(other_y);
+        free(entries);
+        free(last_track);
+        return;
+    }
+    pointStream_positions(track, sample, n, track_x, track_y);
+
+    // squared_distance scales x down by the correction factor, so cells have to be wider in x
+    float min_correction = 1.0f;
+    int min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
+    for (int i = 0; i < n; i++)
+    {
+        int x = track_x[i];
+        int y = track_y[i];
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            float correction = get_x_correction_factor(y + dy * (int)HEAT_RADIUS);
+            if (correction < min_correction)
+                min_correction = correction;
+        }
+        if (x < min_x)
+            min_x = x;
+        if (x > max_x)
+            max_x = x;
+        if (y < min_y)
+            min_y = y;
+        if (y > max_y)
+            max_y = y;
+    }
+    int cell_w = (int)((HEAT_RADIUS + 1.0f) / min_correction) + 1;
+    int cell_h = (int)HEAT_RADIUS + 1;
+
+    for (int i = 0; i < n; i++)
+    {
+        entries[i].cell = heatGrid_key((track_x[i] - min_x) / cell_w, (track_y[i] - min_y) / cell_h);
+        entries[i].point = i;
+        last_track[i] = -1;
+        if (delta > 0)
+            track->heat[sample ? sample[i] : i] = 0;
+    }
+    qsort(entries, n, sizeof(HeatCellEntry), compare_cell_entries);
+
+    // every other track is visited once, so last_track is enough to count each track once per point
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        GpxTrack *other = &collection->tracks[t];
+        if (t == track_id || !other->visible_in_list)
+            continue;
+        if (!trackPyramid_intersects(other, (int64_t)min_x - cell_w, (int64_t)min_y - cell_h, (int64_t)max_x + cell_w, (int64_t)max_y + cell_h))
+            continue;
+
+        int other_n;
+        const int *other_sample = trackPyramid_heat_samples(&collection->pyramid, other, &other_n);
+        pointStream_positions(other, other_sample, other_n, other_x, other_y);
+        for (int j = 0; j < other_n; j++)
+        {
+            int q = other_sample ? other_sample[j] : j;
+            int qx = other_x[j];
+            int qy = other_y[j];
+            if (qx < min_x - cell_w || qx > max_x + cell_w ||
+                qy < min_y - cell_h || qy > max_y + cell_h)
+                continue;
+
+            float q_correction = get_x_correction_factor(qy);
+            int cell_x = (qx - min_x + cell_w) / cell_w - 1;
+            int cell_y = (qy - min_y + cell_h) / cell_h - 1;
+            bool hit = false;
+
+            for (int cy = cell_y - 1; cy <= cell_y + 1; cy++)
+            {
+                for (int cx = cell_x - 1; cx <= cell_x + 1; cx++)
+                {
+                    if (cx < 0 || cy < 0)
+                        continue;
+                    uint64_t cell = heatGrid_key(cx, cy);
+                    for (int k = find_cell(entries, n, cell); k < n && entries[k].cell == cell; k++)
+                    {
+                        int index = entries[k].point;
+                        int p = sample ? sample[index] : index;
+                        int px = track_x[index];
+                        int py = track_y[index];
+                        if (!hit && squared_distance_xy(px, py, qx, qy, q_correction) <= radius2)
+                            hit = true;
+                        if (delta > 0 && last_track[index] != t &&
+                            squared_distance_xy(qx, qy, px, py, get_x_correction_factor(py)) <= radius2)
+                        {
+                            last_track[index] = t;
+                            track->heat[p] = pointHeat_clamp(track->heat[p] + 1);
+                        }
+                    }
+                }
+            }
+            if (hit)
+                other->heat[q] = pointHeat_clamp(other->heat[q] + delta);
+        }
+    }
+
+    free(track_x);
+    free(track_y);
+    free(other_x);
+    free(other_y);
+    free(entries);
+    free(last_track);
+
+    int max_heat = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        GpxTrack *current = &collection->tracks[t];
+        if (!current->visible_in_list)
+            continue;
+        trackPyramid_spread_heat(&collection->pyramid, current);
+        for (int j = 0; j < current->total_points; j++)
+        {
+            if (current->heat[j] > max_heat)
+                max_heat = current->heat[j];
+        }
+    }
+    collection->max_heat = max_heat;
+}
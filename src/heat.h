@@ -5,8 +5,26 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <stdatomic.h>
 #include "structs.h"
+#include "pyramid.h"
+#include "pointarena.h"
+#include "trace.h"
+#include "memstat.h"
+#include "heatgrid.h"
+#include "kdtree.h"
+#include "tracks.h"
 
+#define HEAT_RADIUS 200.0f
+#define HEAT_MIN_X_CORRECTION 0.09f // smallest factor of get_x_correction_factor
+#define HEAT_RESCALE_STEP 4         // a running heat job redraws all tiles when the maximum grows by a quarter
+
+float get_x_correction_factor(int world_y);
+int heat_worker_count(void);
 bool calculate_heatmap(GpxCollection *collection);
+bool heatJob_start(HeatJob *job, GpxCollection *collection, LoadProgress *progress);
+bool heatJob_apply(HeatJob *job, GpxCollection *collection);
+void heatJob_stop(HeatJob *job);
+void update_heatmap_for_track(GpxCollection *collection, int track_id, int delta);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "heatgrid.h"
+
+// Spatial hash for the heat calculation. The samples are bucketed by row with a counting sort,
+// each row is then sorted by x, which also sorts it by cell. The cell table is built from the
+// sorted points and looked up with a binary search, a neighbourhood is three contiguous ranges.
+
+static int compare_grid_points_x(const void *a, const void *b)
+{
+    int x1 = ((const HeatSample *)a)->world_x;
+    int x2 = ((const HeatSample *)b)->world_x;
+    return (x1 > x2) - (x1 < x2);
+}
+
+uint64_t heatGrid_key(int cell_x, int cell_y)
+{
+    return ((uint64_t)(uint32_t)cell_y << 32) | (uint32_t)cell_x;
+}
+
+static uint64_t heatGrid_point_key(const HeatGrid *grid, const HeatSample *point)
+{
+    return heatGrid_key((point->world_x - grid->min_x) / grid->cell_w, (point->world_y - grid->min_y) / grid->cell_h);
+}
+
+bool heatGrid_build(HeatGrid *grid, const PointColumns *columns)
+{
+    int n = columns->count;
+    memset(grid, 0, sizeof(HeatGrid));
+    grid->cell_w = 1;
+    grid->cell_h = 1;
+
+    // squared_distance scales x down by the correction factor of the searching point, so cells
+    // are as wide as the smallest factor needs
+    float min_correction = 1.0f;
+    int min_x = INT32_MAX, min_y = INT32_MAX, max_y = INT32_MIN;
+    for (int i = 0; i < n; i++)
+    {
+        float correction = get_x_correction_factor(columns->world_y[i]);
+        if (correction < min_correction)
+            min_correction = correction;
+        if (columns->world_x[i] < min_x)
+            min_x = columns->world_x[i];
+        if (columns->world_y[i] < min_y)
+            min_y = columns->world_y[i];
+        if (columns->world_y[i] > max_y)
+            max_y = columns->world_y[i];
+    }
+    if (n > 0)
+    {
+        grid->min_x = min_x;
+        grid->min_y = min_y;
+        grid->cell_w = (int)((HEAT_RADIUS + 1.0f) / min_correction) + 1;
+        grid->cell_h = (int)HEAT_RADIUS + 1;
+    }
+    int rows = n > 0 ? (int)(((int64_t)max_y - min_y) / grid->cell_h) + 1 : 0;
+
+    grid->points = (HeatSample *)malloc((n > 0 ? n : 1) * sizeof(HeatSample));
+    int *row_start = (int *)calloc(rows + 2, sizeof(int));
+    if (!grid->points || !row_start)
+    {
+        perror("malloc failed");
+        free(row_start);
+        heatGrid_free(grid);
+        return false;
+    }
+
+    for (int i = 0; i < n; i++)
+        row_start[(columns->world_y[i] - min_y) / grid->cell_h + 2]++;
+    for (int r = 2; r <= rows + 1; r++)
+        row_start[r] += row_start[r - 1];
+    // row_start[r + 1] is now the next free slot of row r
+    for (int i = 0; i < n; i++)
+    {
+        int row = (columns->world_y[i] - min_y) / grid->cell_h;
+        HeatSample *point = &grid->points[row_start[row + 1]++];
+        point->world_x = columns->world_x[i];
+        point->world_y = columns->world_y[i];
+        point->track_id = columns->track_id[i];
+        point->point = i;
+    }
+    // row_start[r] is now the start of row r
+    for (int r = 0; r < rows; r++)
+    {
+        int count = row_start[r + 1] - row_start[r];
+        if (count > 1)
+            qsort(&grid->points[row_start[r]], count, sizeof(HeatSample), compare_grid_points_x);
+    }
+    free(row_start);
+    grid->point_count = n;
+
+    int cells = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (i == 0 || heatGrid_point_key(grid, &grid->points[i]) != heatGrid_point_key(grid, &grid->points[i - 1]))
+            cells++;
+    }
+    grid->cells = (HeatGridCell *)malloc((cells + 1) * sizeof(HeatGridCell));
+    if (!grid->cells)
+    {
+        perror("malloc failed");
+        heatGrid_free(grid);
+        return false;
+    }
+    int cell = 0;
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t key = heatGrid_point_key(grid, &grid->points[i]);
+        if (cell > 0 && grid->cells[cell - 1].key == key)
+            continue;
+        grid->cells[cell].key = key;
+        grid->cells[cell].first = i;
+        cell++;
+    }
+    grid->cells[cells].key = UINT64_MAX;
+    grid->cells[cells].first = n;
+    grid->cell_count = cells;
+    return true;
+}
+
+void heatGrid_free(HeatGrid *grid)
+{
+    free(grid->points);
+    free(grid->cells);
+    grid->points = NULL;
+    grid->cells = NULL;
+    grid->point_count = 0;
+    grid->cell_count = 0;
+}
+
+size_t heatGrid_bytes(const HeatGrid *grid)
+{
+    return (size_t)grid->point_count * sizeof(HeatSample) + (size_t)(grid->cell_count + 1) * sizeof(HeatGridCell);
+}
+
+// First cell whose key is not below key, cell_count if there is none
+static int heatGrid_lower_bound(const HeatGrid *grid, uint64_t key)
+{
+    int low = 0, high = grid->cell_count;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (grid->cells[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Points of the cells cell_x - 1 to cell_x + 1 of row cell_y, empty if first == end
+void heatGrid_row_range(const HeatGrid *grid, int cell_x, int cell_y, int *first, int *end)
+{
+    if (cell_y < 0)
+    {
+        *first = *end = 0;
+        return;
+    }
+    int from = heatGrid_lower_bound(grid, heatGrid_key(cell_x > 0 ? cell_x - 1 : 0, cell_y));
+    int to = heatGrid_lower_bound(grid, heatGrid_key(cell_x + 2, cell_y));
+    *first = grid->cells[from].first;
+    *end = grid->cells[to].first;
+}
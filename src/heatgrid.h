@@ -0,0 +1,17 @@
+#ifndef heatgrid_h
+#define heatgrid_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "heat.h"
+
+bool heatGrid_build(HeatGrid *grid, const PointColumns *columns);
+void heatGrid_free(HeatGrid *grid);
+size_t heatGrid_bytes(const HeatGrid *grid);
+uint64_t heatGrid_key(int cell_x, int cell_y);
+void heatGrid_row_range(const HeatGrid *grid, int cell_x, int cell_y, int *first, int *end);
+
+#endif
@@ -0,0 +1,193 @@
+#include "kdtree.h"
+
+// Flat kd-tree over the heat samples. The build reorders one array of points in place: the
+// median of each range is selected in linear time, the halves become the children. There are
+// no nodes and no shared state, subtrees near the root are built in parallel.
+
+typedef struct
+{
+    HeatSample *points;
+    int lo;
+    int hi;
+    int depth;
+} KdBuildTask;
+
+static inline int kdTree_coordinate(const HeatSample *point, int axis)
+{
+    return axis == 0 ? point->world_x : point->world_y;
+}
+
+static inline void kdTree_swap(HeatSample *a, HeatSample *b)
+{
+    HeatSample tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+// Reorder points[lo, hi) so that points[k] is the one a sort on axis would put there, with no
+// larger one before and no smaller one after it
+static void kdTree_select(HeatSample *points, int lo, int hi, int k, int axis)
+{
+    hi--;
+    while (lo < hi)
+    {
+        // median of three as pivot, it ends up at points[mid]
+        int mid = lo + (hi - lo) / 2;
+        if (kdTree_coordinate(&points[mid], axis) < kdTree_coordinate(&points[lo], axis))
+            kdTree_swap(&points[mid], &points[lo]);
+        if (kdTree_coordinate(&points[hi], axis) < kdTree_coordinate(&points[lo], axis))
+            kdTree_swap(&points[hi], &points[lo]);
+        if (kdTree_coordinate(&points[hi], axis) < kdTree_coordinate(&points[mid], axis))
+            kdTree_swap(&points[hi], &points[mid]);
+        int pivot = kdTree_coordinate(&points[mid], axis);
+
+        int i = lo, j = hi;
+        while (i <= j)
+        {
+            while (kdTree_coordinate(&points[i], axis) < pivot)
+                i++;
+            while (kdTree_coordinate(&points[j], axis) > pivot)
+                j--;
+            if (i <= j)
+            {
+                kdTree_swap(&points[i], &points[j]);
+                i++;
+                j--;
+            }
+        }
+        // [lo, j] <= pivot, [i, hi] >= pivot and everything between equals the pivot
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            return;
+    }
+}
+
+static void *kdTree_build_range(void *arg)
+{
+    KdBuildTask *task = (KdBuildTask *)arg;
+    HeatSample *points = task->points;
+    int lo = task->lo, hi = task->hi, depth = task->depth;
+
+    while (hi - lo > KD_LEAF_SIZE)
+    {
+        int mid = lo + (hi - lo) / 2;
+        kdTree_select(points, lo, hi, mid, depth % 2);
+
+        KdBuildTask left = {points, lo, mid, depth + 1};
+        pthread_t thread;
+        bool threaded = depth < KD_PARALLEL_DEPTH && hi - lo >= KD_PARALLEL_MIN &&
+                        pthread_create(&thread, NULL, kdTree_build_range, &left) == 0;
+        if (!threaded)
+            kdTree_build_range(&left);
+
+        // the middle point stays where it is, the right half is built by this thread
+        lo = mid + 1;
+        depth++;
+        if (threaded)
+        {
+            KdBuildTask right = {points, lo, hi, depth};
+            kdTree_build_range(&right);
+            pthread_join(thread, NULL);
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+bool kdTree_build(KdTree *tree, const PointColumns *columns)
+{
+    int n = columns->count;
+    tree->count = n;
+    tree->points = (HeatSample *)malloc((n > 0 ? n : 1) * sizeof(HeatSample));
+    if (!tree->points)
+    {
+        perror("malloc failed");
+        tree->count = 0;
+        return false;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        tree->points[i].world_x = columns->world_x[i];
+        tree->points[i].world_y = columns->world_y[i];
+        tree->points[i].track_id = columns->track_id[i];
+        tree->points[i].point = i;
+    }
+
+    KdBuildTask root = {tree->points, 0, n, 0};
+    kdTree_build_range(&root);
+    return true;
+}
+
+void kdTree_free(KdTree *tree)
+{
+    free(tree->points);
+    tree->points = NULL;
+    tree->count = 0;
+}
+
+size_t kdTree_bytes(const KdTree *tree)
+{
+    return (size_t)tree->count * sizeof(HeatSample);
+}
+
+void kdQuery_init(KdQuery *query, const KdTree *tree, int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y)
+{
+    query->tree = tree;
+    query->min_x = min_x;
+    query->min_y = min_y;
+    query->max_x = max_x;
+    query->max_y = max_y;
+    query->top = 0;
+    query->leaf = query->leaf_end = 0;
+    query->index = -1;
+    if (tree->count > 0)
+    {
+        KdRange root = {0, tree->count, 0};
+        query->stack[query->top++] = root;
+    }
+}
+
+// Next point inside the box, its position in tree->points is in query->index
+bool kdQuery_next(KdQuery *query)
+{
+    const HeatSample *points = query->tree->points;
+    while (true)
+    {
+        while (query->leaf < query->leaf_end)
+        {
+            const HeatSample *point = &points[query->leaf++];
+            if (point->world_x >= query->min_x && point->world_x <= query->max_x &&
+                point->world_y >= query->min_y && point->world_y <= query->max_y)
+            {
+                query->index = query->leaf - 1;
+                return true;
+            }
+        }
+        if (query->top == 0)
+            return false;
+
+        KdRange range = query->stack[--query->top];
+        if (range.hi - range.lo <= KD_LEAF_SIZE)
+        {
+            query->leaf = range.lo;
+            query->leaf_end = range.hi;
+            continue;
+        }
+        // the left half is not larger than the middle point, the right half not smaller
+        int mid = range.lo + (range.hi - range.lo) / 2;
+        int axis = range.depth % 2;
+        int64_t split = kdTree_coordinate(&points[mid], axis);
+        int64_t box_min = axis == 0 ? query->min_x : query->min_y;
+        int64_t box_max = axis == 0 ? query->max_x : query->max_y;
+        if (box_max >= split)
+            query->stack[query->top++] = (KdRange){mid + 1, range.hi, range.depth + 1};
+        if (box_min <= split)
+            query->stack[query->top++] = (KdRange){range.lo, mid, range.depth + 1};
+        // the middle point itself is checked like a leaf of one
+        query->leaf = mid;
+        query->leaf_end = mid + 1;
+    }
+}
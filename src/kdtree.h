@@ -0,0 +1,19 @@
+#ifndef kdtree_h
+#define kdtree_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "structs.h"
+
+#define KD_PARALLEL_DEPTH 3    // subtrees above this depth are built in their own thread
+#define KD_PARALLEL_MIN 65536  // smaller subtrees are built by the thread that split them
+
+bool kdTree_build(KdTree *tree, const PointColumns *columns);
+void kdTree_free(KdTree *tree);
+size_t kdTree_bytes(const KdTree *tree);
+void kdQuery_init(KdQuery *query, const KdTree *tree, int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y);
+bool kdQuery_next(KdQuery *query);
+
+#endif
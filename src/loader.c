@@ -0,0 +1,129 @@
+#include "loader.h"
+
+// Import and heat calculation run in the background so the window is usable right away.
+// The import thread fills a staging collection which the main thread adopts in loader_update,
+// the heat job then works on a copy of the points and its results are copied back as they land.
+
+static void *loader_import_thread(void *arg)
+{
+    Loader *loader = (Loader *)arg;
+    trace_set_thread_name("import");
+
+    gpxParser_parse_all_files(&loader->staging, GPX_FOLDER, TRACK_CACHE_PATH, &loader->progress);
+    atomic_store(&loader->progress.stage, LOAD_PARSED);
+    return NULL;
+}
+
+bool loader_start(Loader *loader)
+{
+    memset(&loader->staging, 0, sizeof(loader->staging));
+    atomic_store(&loader->progress.done, 0);
+    atomic_store(&loader->progress.total, 0);
+    atomic_store(&loader->progress.cancel, false);
+    atomic_store(&loader->progress.stage, LOAD_PARSING);
+
+    if (pthread_create(&loader->thread, NULL, loader_import_thread, loader) != 0)
+    {
+        fprintf(stderr, "Failed to create import thread\n");
+        atomic_store(&loader->progress.stage, LOAD_IDLE);
+        return false;
+    }
+    return true;
+}
+
+// Cancel the import or heat job that is still running and wait for its threads, called at exit
+// before the collection is freed. Parsed tracks the main thread has not adopted yet are dropped.
+void loader_stop(Loader *loader)
+{
+    atomic_store(&loader->progress.cancel, true);
+
+    int stage = atomic_load(&loader->progress.stage);
+    if (stage == LOAD_PARSING || stage == LOAD_PARSED)
+    {
+        pthread_join(loader->thread, NULL);
+        pointArena_free(&loader->staging.point_arena);
+        trackPyramid_free(&loader->staging.pyramid);
+        free(loader->staging.tracks);
+        free(loader->staging.list_order);
+        memset(&loader->staging, 0, sizeof(loader->staging));
+    }
+    else if (stage == LOAD_HEAT)
+    {
+        heatJob_stop(&loader->heat);
+    }
+    atomic_store(&loader->progress.stage, LOAD_IDLE);
+}
+
+bool loader_busy(Loader *loader)
+{
+    int stage = atomic_load(&loader->progress.stage);
+    return stage == LOAD_PARSING || stage == LOAD_PARSED || stage == LOAD_HEAT;
+}
+
+bool loader_start_heat(Loader *loader, GpxCollection *collection)
+{
+    if (loader_busy(loader))
+        return false;
+
+    if (!heatJob_start(&loader->heat, collection, &loader->progress))
+        return false;
+
+    atomic_store(&loader->progress.stage, LOAD_HEAT);
+    loader->last_refresh = SDL_GetTicks();
+    return true;
+}
+
+// Called once per frame from the main loop, returns true when the window has to be redrawn
+bool loader_update(Loader *loader, GpxCollection *collection)
+{
+    int stage = atomic_load(&loader->progress.stage);
+
+    if (stage == LOAD_PARSED)
+    {
+        pthread_join(loader->thread, NULL);
+
+        // hand the imported tracks to the main thread, tracks are drawn with their default heat until it is known
+        collection->tracks = loader->staging.tracks;
+        collection->total_tracks = loader->staging.total_tracks;
+        collection->point_arena = loader->staging.point_arena;
+        collection->pyramid = loader->staging.pyramid;
+        collection->list_order = loader->staging.list_order;
+        memset(&loader->staging, 0, sizeof(loader->staging));
+
+        apply_filter_values(collection);
+        free_track_tile_cache(&collection->track_tile_cache);
+
+        atomic_store(&loader->progress.stage, LOAD_IDLE);
+        if (!loader_start_heat(loader, collection))
+            atomic_store(&loader->progress.stage, LOAD_DONE);
+        return true;
+    }
+
+    if (stage == LOAD_HEAT)
+    {
+        bool finished = atomic_load(&loader->heat.finished);
+        Uint32 now = SDL_GetTicks();
+        if (!finished && now - loader->last_refresh < LOADER_REFRESH_MS)
+            return false;
+        loader->last_refresh = now;
+
+        // only the tiles of tracks with new heat are drawn again, all of them if the scale moved
+        if (heatJob_apply(&loader->heat, collection))
+        {
+            atomic_store(&loader->progress.stage, LOAD_DONE);
+            printf("Maximum heat is %d\n", collection->max_heat);
+        }
+        return true;
+    }
+
+    // keep the progress display moving during the import
+    if (stage == LOAD_PARSING)
+    {
+        Uint32 now = SDL_GetTicks();
+        if (now - loader->last_refresh < LOADER_REFRESH_MS)
+            return false;
+        loader->last_refresh = now;
+        return true;
+    }
+    return false;
+}
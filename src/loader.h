@@ -0,0 +1,25 @@
+#ifndef loader_h
+#define loader_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+#include "structs.h"
+#include "gpxParser.h"
+#include "filters.h"
+#include "heat.h"
+#include "tracks.h"
+#include "trace.h"
+
+#define LOADER_REFRESH_MS 250 // how often partial heat results are shown
+
+bool loader_start(Loader *loader);
+bool loader_update(Loader *loader, GpxCollection *collection);
+bool loader_start_heat(Loader *loader, GpxCollection *collection);
+bool loader_busy(Loader *loader);
+void loader_stop(Loader *loader);
+
+#endif
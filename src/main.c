@@ -3,7 +3,12 @@
 bool download_in_progress;
 extern UIState ui;
 bool use_osm_tiles = true;
+bool use_fast_gpx_parser = true;
+int heat_sample_spacing = HEAT_SAMPLE_SPACING;
+HeatIndex heat_index = HEAT_INDEX_GRID;
+int heat_threads = 0; // 0 for one per online CPU
 SDL_Event event;
+Loader loader;
 
 bool animation_in_progress(UIState ui)
 {
@@ -30,19 +35,70 @@ void append_to_input_buffer(UIState *ui, char c)
 
 int main(int argc, char *argv[])
 {
-  if (argc > 1)
+  const char *batch_folder = NULL;
+  const char *batch_output = NULL;
+  bool batch_binary = false;
+  const char *trace_path = NULL;
+
+  for (int i = 1; i < argc; i++)
   {
-    if (argc == 2 && strcmp(argv[1], "-stadiamaps") == 0)
+    if (strcmp(argv[i], "-stadiamaps") == 0)
     {
       printf("using stadiamaps\n");
       use_osm_tiles = false;
     }
+    else if (strcmp(argv[i], "-nofastparse") == 0)
+    {
+      printf("gpx fast path disabled, parsing with libxml2 only\n");
+      use_fast_gpx_parser = false;
+    }
+    else if (strcmp(argv[i], "-heatspacing") == 0 && i + 1 < argc)
+    {
+      heat_sample_spacing = atoi(argv[++i]);
+      printf("heat is calculated on points %d world units apart\n", heat_sample_spacing);
+    }
+    else if (strcmp(argv[i], "-heatindex") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "grid") == 0 || strcmp(argv[i + 1], "kdtree") == 0))
+    {
+      heat_index = strcmp(argv[++i], "grid") == 0 ? HEAT_INDEX_GRID : HEAT_INDEX_KDTREE;
+      printf("heat neighbours are searched with the %s\n", heat_index == HEAT_INDEX_GRID ? "grid" : "kd-tree");
+    }
+    else if (strcmp(argv[i], "-heatthreads") == 0 && i + 1 < argc)
+    {
+      heat_threads = atoi(argv[++i]);
+      printf("heat is calculated in %d threads\n", heat_worker_count());
+    }
+    else if (strcmp(argv[i], "-batch") == 0 && i + 2 < argc)
+    {
+      batch_folder = argv[++i];
+      batch_output = argv[++i];
+    }
+    else if (strcmp(argv[i], "-binary") == 0)
+    {
+      batch_binary = true;
+    }
+    else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+    {
+      trace_path = argv[++i];
+    }
     else
     {
-      printf("The only supported argument is \"-stadiamaps\"\n");
+      printf("Supported arguments are \"-stadiamaps\", \"-nofastparse\", \"-heatspacing <units>\", \"-heatindex grid|kdtree\", \"-heatthreads <count>\", \"-trace <file>\" and \"-batch <folder> <output> [-binary]\"\n");
       exit(1);
     }
   }
+
+  // timeline of all threads, written on exit and with F4
+  if (trace_path && trace_start(trace_path))
+    printf("recording a trace to %s\n", trace_path);
+
+  // headless run without a window, results go to files
+  if (batch_folder)
+  {
+    bool ok = batch_run(batch_folder, batch_output, batch_binary);
+    trace_shutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  uint64_t startup_trace = trace_begin();
   struct application appl = {
       .window = NULL,
       .renderer = NULL,
@@ -63,11 +119,11 @@ int main(int argc, char *argv[])
       .download_queue.write_p = 0,
       .show_heat = true,
       .update_window = true,
+      .gpx_watcher.inotify_fd = -1,
   };
   download_in_progress = false;
 
-  int order[gpxParser_count_gpx_files()];
-  GpxCollection collection = {.list_order = order};
+  GpxCollection collection = {0};
 
   if (sdl_initialize(&appl))
     appl_cleanup(&appl, &collection, EXIT_FAILURE);
@@ -77,13 +133,17 @@ int main(int argc, char *argv[])
   clay_init(&appl);
   SDL_RenderPresent(appl.renderer);
 
-  gpxParser_parse_all_files(&collection);
-
   reset_filters(&collection.filters);
   apply_filter_values(&collection);
 
-  calculate_heatmap(&collection);
-  printf("Maximum heat is %d\n", collection.max_heat);
+  gpxParser_init();
+
+  // watch the folder before the import so nothing synced during it gets lost,
+  // files that are imported twice just replace their own track
+  watcher_start(&appl.gpx_watcher, GPX_FOLDER);
+
+  // import and heat run in the background, tracks show up once they are parsed
+  loader_start(&loader);
 
   // start thread that will donwload missing tiles of the map
   // the thread will constantly check the download queue for missing tiles and download them
@@ -96,47 +156,56 @@ int main(int argc, char *argv[])
     return 1;
   }
   pthread_detach(dl_thread);
+  trace_end("startup", NULL, startup_trace);
 
   appl.lastFrameTime = SDL_GetTicks();
 
   Uint32 frameTime;
-  int fpsCounter = 0;
-  float fpsTimer = 0;
 
   // Main-Loop
   while (appl.running)
   {
     appl.lastFrameTime = SDL_GetTicks();
+    Uint64 frame_start = perf_now();
+    perf_frame_begin(&appl.perf);
     SDL_GetWindowSize(appl.window, &appl.window_width,
                       &appl.window_height);
     handle_events(&appl, &collection);
+    perf_add(&appl.perf, PERF_EVENTS, frame_start);
+
+    if (loader_update(&loader, &collection))
+      appl.update_window = true;
+
+    // folder changes wait until the loader is done with the collection
+    if (!loader_busy(&loader) && watcher_apply_updates(&appl.gpx_watcher, &appl, &collection))
+      appl.update_window = true;
 
     if (appl.update_window || animation_in_progress(ui) || download_in_progress)
     {
       appl.update_window = false;
+      uint64_t frame_trace = trace_begin();
       SDL_RenderClear(appl.renderer);
 
-      update_track_info_graphs(&appl, collection);
+      update_track_info_graphs(&appl, &collection);
 
+      Uint64 stage_start = perf_now();
       update_selected_track_overlay(&appl, &collection);
+      perf_add(&appl.perf, PERF_OVERLAY, stage_start);
 
       get_map_background(&appl, &collection);
 
       clay_draw_UI(&appl, &collection);
 
+      stage_start = perf_now();
       SDL_RenderPresent(appl.renderer);
+      perf_add(&appl.perf, PERF_PRESENT, stage_start);
+      perf_add(&appl.perf, PERF_FRAME, frame_start);
+      perf_frame_presented(&appl.perf);
+      trace_end("frame", NULL, frame_trace);
     }
 
-    // FPS counter
-    fpsTimer += get_delta_time(appl.lastFrameTime);
-    fpsCounter++;
-
-    if (fpsTimer >= 1.0f)
-    {
-      appl.currentFPS = fpsCounter;
-      fpsCounter = 0;
-      fpsTimer = 0.0f;
-    }
+    // FPS counts presented frames, not loop iterations
+    perf_update_window(&appl.perf, &appl.currentFPS);
 
     frameTime = SDL_GetTicks() - appl.lastFrameTime;
     if (frameTime < FRAME_DELAY_MS)
@@ -152,7 +221,13 @@ int main(int argc, char *argv[])
 
 bool appl_cleanup(struct application *appl, GpxCollection *collection, int exit_status)
 {
+  // the import and heat threads use the collection and libxml2, both are torn down below
   printf("Clean threads...\n");
+  loader_stop(&loader);
+  watcher_stop(&appl->gpx_watcher);
+  trace_shutdown();
+  memstat_sample_tracks(collection);
+  memstat_print();
   pthread_mutex_destroy(&appl->download_queue.lock);
   // pthread_cond_destroy(&appl->download_queue.cond);
   printf("Clean textures...\n");
@@ -160,6 +235,12 @@ bool appl_cleanup(struct application *appl, GpxCollection *collection, int exit_
   SDL_DestroyTexture(appl->tex_tracks);
   free_tile_cache(&(appl->tile_cache));
   free_track_tile_cache(&collection->track_tile_cache);
+  printf("Clean tracks...\n");
+  pointArena_free(&collection->point_arena);
+  trackPyramid_free(&collection->pyramid);
+  free(collection->tracks);
+  free(collection->list_order);
+  gpxParser_cleanup();
   printf("Clean UI...\n");
   clay_free_memory();
   printf("Clean renderer...\n");
@@ -339,7 +420,20 @@ bool handle_events(struct application *appl, GpxCollection *collection)
     }
     else if (event.type == SDL_KEYDOWN)
     {
-      if (event.key.keysym.sym == SDLK_TAB)
+      if (event.key.keysym.sym == SDLK_F3)
+      {
+        appl->perf.show_hud = !appl->perf.show_hud;
+      }
+      else if (event.key.keysym.sym == SDLK_F4)
+      {
+        trace_dump();
+      }
+      else if (event.key.keysym.sym == SDLK_F5)
+      {
+        memstat_sample_tracks(collection);
+        memstat_print();
+      }
+      else if (event.key.keysym.sym == SDLK_TAB)
       {
         if (ui.run_list.animation > 0)
         {
@@ -11,6 +11,12 @@
 #include "tracks.h"
 #include "filters.h"
 #include "heat.h"
+#include "watcher.h"
+#include "loader.h"
+#include "batch.h"
+#include "perf.h"
+#include "trace.h"
+#include "memstat.h"
 
 
 bool sdl_initialize(struct application *appl);
@@ -57,6 +57,7 @@ static size_t write_callback(void *contents, size_t size, size_t nmemb, void *us
 void *download_tiles(void *arg)
 {
     struct fifo *download_queue = (struct fifo *)arg;
+    trace_set_thread_name("tile download");
     MapTile next_tile = {0};
     while (true)
     {
@@ -77,6 +78,7 @@ void *download_tiles(void *arg)
                  next_tile.tile_x, next_tile.tile_y);
 
         printf("Start download for: %s\n", tile_path);
+        uint64_t trace_start_ns = trace_begin();
         // Ensure that all needed directories exist
         char zoom_dir[64], x_dir[64];
         snprintf(zoom_dir, sizeof(zoom_dir), "tilecache/%d", next_tile.zoom);
@@ -140,6 +142,7 @@ void *download_tiles(void *arg)
             fclose(f);
         }
         free(image_data.memory);
+        trace_end("tile download", tile_path, trace_start_ns);
     }
 }
 
@@ -164,7 +167,10 @@ void free_tile_cache(TileTextureCache *cache)
     for (int i = 0; i < cache->size; i++)
     {
         if (cache->entries[i].texture)
+        {
+            memstat_remove_texture(MEM_MAP_TILES, cache->entries[i].texture);
             SDL_DestroyTexture(cache->entries[i].texture);
+        }
     }
     free(cache->entries);
     cache->entries = NULL;
@@ -179,19 +185,24 @@ SDL_Texture *get_cached_texture(struct application *appl, MapTile key, const cha
     {
         if (tile_key_equal(appl->tile_cache.entries[i].key, key))
         {
+            appl->perf.tile_hits++;
             return appl->tile_cache.entries[i].texture;
         }
     }
+    appl->perf.tile_misses++;
 
     // Load it from disk
+    uint64_t trace_start_ns = trace_begin();
     SDL_Surface *surface = IMG_Load(path);
     if (!surface)
         return NULL;
 
     SDL_Texture *texture = SDL_CreateTextureFromSurface(appl->renderer, surface);
     SDL_FreeSurface(surface);
+    trace_end("tile decode", path, trace_start_ns);
     if (!texture)
         return NULL;
+    memstat_add_texture(MEM_MAP_TILES, texture);
 
     // Store in cache
     TileTexture entry = {key, texture};
@@ -207,6 +218,7 @@ int file_exists(const char *path)
 
 bool get_map_background(struct application *appl, GpxCollection *collection)
 {
+    TRACE_SCOPE("map background");
     // How many tiles do we need?
     int tiles_x = appl->window_width / TILE_SIZE + 2;
     int tiles_y = appl->window_height / TILE_SIZE + 2;
@@ -268,6 +280,7 @@ bool get_map_background(struct application *appl, GpxCollection *collection)
             }
 
             MapTile key = {tile_x, tile_y, appl->zoom};
+            Uint64 stage_start = perf_now();
             SDL_Texture *texture = get_cached_texture(appl, key, tile_path);
             int screen_x = (tile_x - center_tile_x) * TILE_SIZE - tile_offset_x + appl->window_width / 2;
             int screen_y = (tile_y - center_tile_y) * TILE_SIZE - tile_offset_y + appl->window_height / 2;
@@ -277,7 +290,9 @@ bool get_map_background(struct application *appl, GpxCollection *collection)
                 SDL_Rect dest = {screen_x, screen_y, TILE_SIZE, TILE_SIZE};
                 SDL_RenderCopy(appl->renderer, texture, NULL, &dest);
             }
+            perf_add(&appl->perf, PERF_MAP_TILES, stage_start);
 
+            stage_start = perf_now();
             SDL_Texture *trackTex = get_or_render_track_tile(appl, collection, key);
             if (trackTex)
             {
@@ -288,6 +303,7 @@ bool get_map_background(struct application *appl, GpxCollection *collection)
                     .h = 256};
                 SDL_RenderCopy(appl->renderer, trackTex, NULL, &dst);
             }
+            perf_add(&appl->perf, PERF_TRACK_TILES, stage_start);
         }
     }
     if (appl->selected_track_overlay[appl->zoom])
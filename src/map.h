@@ -9,6 +9,9 @@
 #include "structs.h"
 #include "fifo.h"
 #include "tracks.h"
+#include "perf.h"
+#include "trace.h"
+#include "memstat.h"
 
 bool get_map_background(struct application *appl, GpxCollection* collection);
 void *download_tiles(void *arg);
@@ -0,0 +1,131 @@
+#include "memstat.h"
+
+// Live bytes and allocation counts per subsystem. The big allocations report themselves here
+// when they grow or are released, textures count their pixels as GPU memory.
+
+static atomic_size_t memstat_bytes[MEM_TAG_COUNT];
+static atomic_int memstat_count[MEM_TAG_COUNT];
+
+static const char *memstat_names[MEM_TAG_COUNT] = {
+    "Points",
+    "Hot tracks",
+    "Track pyramids",
+    "Track metadata",
+    "Heat calculation",
+    "Clay arena",
+    "Map tiles (GPU)",
+    "Track tiles (GPU)",
+    "Overlays (GPU)",
+};
+
+void memstat_alloc(MemTag tag, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    atomic_fetch_add_explicit(&memstat_bytes[tag], bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&memstat_count[tag], 1, memory_order_relaxed);
+}
+
+void memstat_free(MemTag tag, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    atomic_fetch_sub_explicit(&memstat_bytes[tag], bytes, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&memstat_count[tag], 1, memory_order_relaxed);
+}
+
+// A realloc, the allocation is only counted once
+void memstat_resize(MemTag tag, size_t old_bytes, size_t new_bytes)
+{
+    if (old_bytes == 0)
+    {
+        memstat_alloc(tag, new_bytes);
+        return;
+    }
+    if (new_bytes == 0)
+    {
+        memstat_free(tag, old_bytes);
+        return;
+    }
+    if (new_bytes > old_bytes)
+        atomic_fetch_add_explicit(&memstat_bytes[tag], new_bytes - old_bytes, memory_order_relaxed);
+    else
+        atomic_fetch_sub_explicit(&memstat_bytes[tag], old_bytes - new_bytes, memory_order_relaxed);
+}
+
+static size_t memstat_texture_bytes(SDL_Texture *texture)
+{
+    Uint32 format;
+    int w, h;
+    if (!texture || SDL_QueryTexture(texture, &format, NULL, &w, &h) != 0)
+        return 0;
+    return (size_t)w * h * SDL_BYTESPERPIXEL(format);
+}
+
+void memstat_add_texture(MemTag tag, SDL_Texture *texture)
+{
+    memstat_alloc(tag, memstat_texture_bytes(texture));
+}
+
+// Call before SDL_DestroyTexture
+void memstat_remove_texture(MemTag tag, SDL_Texture *texture)
+{
+    memstat_free(tag, memstat_texture_bytes(texture));
+}
+
+// The track array is replaced in several places, its size is taken from the collection instead
+void memstat_sample_tracks(const GpxCollection *collection)
+{
+    atomic_store_explicit(&memstat_bytes[MEM_TRACKS], collection->total_tracks * sizeof(GpxTrack), memory_order_relaxed);
+    atomic_store_explicit(&memstat_count[MEM_TRACKS], collection->tracks ? 1 : 0, memory_order_relaxed);
+}
+
+void memstat_get(MemTag tag, size_t *bytes, int *count)
+{
+    *bytes = atomic_load_explicit(&memstat_bytes[tag], memory_order_relaxed);
+    *count = atomic_load_explicit(&memstat_count[tag], memory_order_relaxed);
+}
+
+bool memstat_is_gpu(MemTag tag)
+{
+    return tag == MEM_MAP_TILES || tag == MEM_TRACK_TILES || tag == MEM_OVERLAYS;
+}
+
+const char *memstat_tag_name(MemTag tag)
+{
+    return memstat_names[tag];
+}
+
+void memstat_format_bytes(char *out, size_t size, size_t bytes)
+{
+    if (bytes >= 1024 * 1024 * 1024)
+        snprintf(out, size, "%.2f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+    else if (bytes >= 1024 * 1024)
+        snprintf(out, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+    else
+        snprintf(out, size, "%.1f KB", bytes / 1024.0);
+}
+
+void memstat_print(void)
+{
+    size_t cpu_total = 0, gpu_total = 0;
+    char formatted[32];
+
+    printf("Memory by subsystem:\n");
+    for (int i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        size_t bytes;
+        int count;
+        memstat_get(i, &bytes, &count);
+        memstat_format_bytes(formatted, sizeof(formatted), bytes);
+        printf("  %-20s %12s in %d allocations\n", memstat_names[i], formatted, count);
+        if (memstat_is_gpu(i))
+            gpu_total += bytes;
+        else
+            cpu_total += bytes;
+    }
+    memstat_format_bytes(formatted, sizeof(formatted), cpu_total);
+    printf("  %-20s %12s\n", "Total CPU", formatted);
+    memstat_format_bytes(formatted, sizeof(formatted), gpu_total);
+    printf("  %-20s %12s\n", "Total GPU", formatted);
+}
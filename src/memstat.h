@@ -0,0 +1,37 @@
+#ifndef memstat_h
+#define memstat_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+#include "structs.h"
+
+typedef enum
+{
+    MEM_POINTS,        // point arena
+    MEM_HOT_TRACKS,    // tracks decoded from the point arena
+    MEM_PYRAMID,       // decimation levels and heat samples
+    MEM_TRACKS,        // GpxTrack array, sampled from the collection
+    MEM_HEAT,          // heat grid or kd-tree and heat job snapshots
+    MEM_CLAY,          // Clay arena
+    MEM_MAP_TILES,     // GPU, map tile textures
+    MEM_TRACK_TILES,   // GPU, track tile textures
+    MEM_OVERLAYS,      // GPU, selected track overlays
+    MEM_TAG_COUNT,
+} MemTag;
+
+void memstat_alloc(MemTag tag, size_t bytes);
+void memstat_free(MemTag tag, size_t bytes);
+void memstat_resize(MemTag tag, size_t old_bytes, size_t new_bytes);
+void memstat_add_texture(MemTag tag, SDL_Texture *texture);
+void memstat_remove_texture(MemTag tag, SDL_Texture *texture);
+void memstat_sample_tracks(const GpxCollection *collection);
+void memstat_get(MemTag tag, size_t *bytes, int *count);
+bool memstat_is_gpu(MemTag tag);
+const char *memstat_tag_name(MemTag tag);
+void memstat_format_bytes(char *out, size_t size, size_t bytes);
+void memstat_print(void);
+
+#endif
@@ -0,0 +1,84 @@
+#include "perf.h"
+
+// Frame timings and cache statistics for the performance HUD. Stage times of the frame being
+// drawn are summed up in current_ms and published once the frame is presented.
+
+static const char *perf_stage_names[PERF_STAGE_COUNT] = {
+    "Events",
+    "Selected track",
+    "Map tiles",
+    "Track tiles",
+    "Clay layout",
+    "Clay render",
+    "Present",
+    "Frame",
+};
+
+Uint64 perf_now(void)
+{
+    return SDL_GetPerformanceCounter();
+}
+
+void perf_frame_begin(PerfStats *perf)
+{
+    memset(perf->current_ms, 0, sizeof(perf->current_ms));
+}
+
+// Add the time since start to a stage of the current frame
+void perf_add(PerfStats *perf, PerfStage stage, Uint64 start)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    perf->current_ms[stage] += (double)(now - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void perf_frame_presented(PerfStats *perf)
+{
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+    {
+        PerfStageStats *stats = &perf->stages[i];
+        float ms = (float)perf->current_ms[i];
+        stats->last_ms = ms;
+        stats->avg_ms = stats->avg_ms == 0.0f ? ms : stats->avg_ms + PERF_AVERAGE_WEIGHT * (ms - stats->avg_ms);
+        if (ms > stats->window_peak_ms)
+            stats->window_peak_ms = ms;
+    }
+    perf->presented_frames++;
+}
+
+static float perf_hit_rate(int hits, int misses)
+{
+    return hits + misses > 0 ? (float)hits / (hits + misses) : -1.0f;
+}
+
+// Called once per loop iteration, closes the window every PERF_WINDOW_MS.
+// Only frames that were presented count for the FPS.
+void perf_update_window(PerfStats *perf, int *current_fps)
+{
+    Uint32 now = SDL_GetTicks();
+    if (perf->window_start == 0)
+        perf->window_start = now;
+    Uint32 elapsed = now - perf->window_start;
+    if (elapsed < PERF_WINDOW_MS)
+        return;
+
+    *current_fps = (int)((perf->presented_frames * 1000 + elapsed / 2) / elapsed);
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+    {
+        perf->stages[i].peak_ms = perf->stages[i].window_peak_ms;
+        perf->stages[i].window_peak_ms = 0.0f;
+    }
+    perf->tile_hit_rate = perf_hit_rate(perf->tile_hits, perf->tile_misses);
+    perf->track_tile_hit_rate = perf_hit_rate(perf->track_tile_hits, perf->track_tile_misses);
+
+    perf->presented_frames = 0;
+    perf->tile_hits = 0;
+    perf->tile_misses = 0;
+    perf->track_tile_hits = 0;
+    perf->track_tile_misses = 0;
+    perf->window_start = now;
+}
+
+const char *perf_stage_name(PerfStage stage)
+{
+    return stage < PERF_STAGE_COUNT ? perf_stage_names[stage] : "";
+}
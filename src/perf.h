@@ -0,0 +1,19 @@
+#ifndef perf_h
+#define perf_h
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "structs.h"
+
+#define PERF_WINDOW_MS 1000   // FPS, peaks and hit rates cover this long
+#define PERF_AVERAGE_WEIGHT 0.1f // weight of the newest frame in the moving average
+
+Uint64 perf_now(void);
+void perf_frame_begin(PerfStats *perf);
+void perf_add(PerfStats *perf, PerfStage stage, Uint64 start);
+void perf_frame_presented(PerfStats *perf);
+void perf_update_window(PerfStats *perf, int *current_fps);
+const char *perf_stage_name(PerfStage stage);
+
+#endif
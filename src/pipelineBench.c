@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "structs.h"
+#include "gpxParser.h"
+#include "filters.h"
+#include "heat.h"
+#include "tracks.h"
+#include "pyramid.h"
+#include "ui.h"
+#include "corpus.h"
+
+// Times every stage of the import and drawing pipeline on a folder of tracks and writes the results as JSON.
+// "generate" writes a synthetic corpus to run it on.
+
+#define BENCH_REPEAT 20          // cheap stages are repeated to get measurable times
+#define BENCH_TILES_PER_ZOOM 64  // at most this many tiles around the center are rendered per zoom level
+
+// the modules expect the globals main.c defines
+bool download_in_progress;
+bool use_osm_tiles = true;
+bool use_fast_gpx_parser = true;
+int heat_sample_spacing = HEAT_SAMPLE_SPACING;
+HeatIndex heat_index = HEAT_INDEX_GRID;
+int heat_threads = 0;
+SDL_Event event;
+Loader loader;
+
+typedef struct
+{
+    char name[32];
+    double seconds;
+    long long items; // points, tracks or tiles the stage went through
+    int repeat;
+} BenchStage;
+
+typedef struct
+{
+    BenchStage stages[32];
+    int count;
+} BenchResults;
+
+static double bench_seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void bench_add(BenchResults *results, const char *name, double seconds, long long items, int repeat)
+{
+    if (results->count >= (int)(sizeof(results->stages) / sizeof(results->stages[0])))
+        return;
+    BenchStage *stage = &results->stages[results->count++];
+    snprintf(stage->name, sizeof(stage->name), "%s", name);
+    stage->seconds = seconds;
+    stage->items = items;
+    stage->repeat = repeat;
+    fprintf(stderr, "%-16s %10.3f ms\n", name, seconds * 1000.0 / repeat);
+}
+
+static long long bench_heat_samples(const GpxCollection *collection)
+{
+    long long total = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        int samples;
+        trackPyramid_heat_samples(&collection->pyramid, &collection->tracks[t], &samples);
+        total += samples;
+    }
+    return total;
+}
+
+// Heat samples of the visible tracks, what calculate_heatmap builds its grid or tree from
+static bool bench_collect_points(GpxCollection *collection, PointColumns *points)
+{
+    int n = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        if (collection->tracks[t].visible_in_list)
+        {
+            int samples;
+            trackPyramid_heat_samples(&collection->pyramid, &collection->tracks[t], &samples);
+            n += samples;
+        }
+    }
+
+    if (!pointColumns_alloc(points, n))
+        return false;
+    int i = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        GpxTrack *track = &collection->tracks[t];
+        if (!track->visible_in_list)
+            continue;
+        int samples;
+        const int *sample = trackPyramid_heat_samples(&collection->pyramid, track, &samples);
+        pointStream_positions(track, sample, samples, &points->world_x[i], &points->world_y[i]);
+        for (int k = 0; k < samples; k++, i++)
+            points->track_id[i] = track->track_id;
+    }
+    return true;
+}
+
+static void bench_project(BenchResults *results, GpxCollection *collection)
+{
+    // resident points only keep the projected position, so the coordinates to project are
+    // reconstructed first and only the forward projection is timed
+    size_t total = collection->point_arena.count;
+    double *coordinates = (double *)malloc((total > 0 ? total : 1) * 2 * sizeof(double));
+    if (!coordinates)
+    {
+        perror("malloc");
+        return;
+    }
+    size_t i = 0;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        PointStream stream;
+        pointStream_init(&stream, &collection->tracks[t]);
+        for (; pointStream_next(&stream); i++)
+            pixelToLatLon(stream.world_x, stream.world_y, MAX_ZOOM, &coordinates[2 * i], &coordinates[2 * i + 1]);
+    }
+
+    struct timespec start;
+    long long checksum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < total; i++)
+    {
+        int x, y;
+        latLonToPixel(coordinates[2 * i], coordinates[2 * i + 1], MAX_ZOOM, &x, &y);
+        checksum += x ^ y;
+    }
+    bench_add(results, "project", bench_seconds_since(&start), (long long)total, 1);
+    if (checksum == 0 && total > 0)
+        fprintf(stderr, "projection returned nothing\n");
+    free(coordinates);
+}
+
+// Stream every encoded point once, what heat sampling and tile rendering pay per point
+static void bench_decode(BenchResults *results, GpxCollection *collection)
+{
+    struct timespec start;
+    long long checksum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        PointStream stream;
+        pointStream_init(&stream, &collection->tracks[t]);
+        while (pointStream_next(&stream))
+            checksum += stream.world_x ^ stream.world_y;
+    }
+    bench_add(results, "decode", bench_seconds_since(&start), (long long)collection->point_arena.count, 1);
+    if (checksum == 0 && collection->point_arena.count > 0)
+        fprintf(stderr, "decoding returned nothing\n");
+    printf("Point arena: %zu points in %zu bytes, %.2f bytes per point with heat\n", collection->point_arena.count, collection->point_arena.size,
+           collection->point_arena.count > 0 ? (collection->point_arena.size + collection->point_arena.count * sizeof(uint16_t)) / (double)collection->point_arena.count : 0.0);
+}
+
+static bool bench_heat_index(BenchResults *results, GpxCollection *collection)
+{
+    PointColumns points;
+    if (!bench_collect_points(collection, &points))
+        return false;
+    KdTree tree;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool ok = kdTree_build(&tree, &points);
+    bench_add(results, "kd_build", bench_seconds_since(&start), points.count, 1);
+    if (ok)
+        kdTree_free(&tree);
+
+    HeatGrid grid;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ok = heatGrid_build(&grid, &points) && ok;
+    bench_add(results, "grid_build", bench_seconds_since(&start), points.count, 1);
+
+    heatGrid_free(&grid);
+    pointColumns_free(&points);
+    return ok;
+}
+
+static void bench_filter_and_sort(BenchResults *results, GpxCollection *collection)
+{
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        reset_filters(&collection->filters);
+        apply_filter_values(collection);
+    }
+    bench_add(results, "filter", bench_seconds_since(&start), collection->total_tracks, BENCH_REPEAT);
+
+    AttributeType criteria[] = {TYPE, DATE, DISTANCE, DURATION, PACE, UPHILL, DOWNHILL, HIGHPOINT};
+    int total_criteria = sizeof(criteria) / sizeof(criteria[0]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        for (int c = 0; c < total_criteria; c++)
+        {
+            // a different criterion than the current one sorts instead of reversing
+            collection->current_sorting = ID;
+            sort_tracks_by(collection, criteria[c]);
+        }
+    }
+    bench_add(results, "sort", bench_seconds_since(&start), (long long)collection->total_tracks * total_criteria, BENCH_REPEAT);
+}
+
+// Render the track tiles around the middle of all tracks into an offscreen software renderer
+static bool bench_tiles(BenchResults *results, GpxCollection *collection)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, TILE_SIZE, TILE_SIZE, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (!surface)
+    {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormat: %s\n", SDL_GetError());
+        return false;
+    }
+    struct application appl = {0};
+    appl.renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!appl.renderer)
+    {
+        fprintf(stderr, "SDL_CreateSoftwareRenderer: %s\n", SDL_GetError());
+        SDL_FreeSurface(surface);
+        return false;
+    }
+
+    int64_t min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
+    for (int t = 0; t < collection->total_tracks; t++)
+    {
+        GpxTrack *track = &collection->tracks[t];
+        if (track->total_points == 0)
+            continue;
+        min_x = track->min_x < min_x ? track->min_x : min_x;
+        min_y = track->min_y < min_y ? track->min_y : min_y;
+        max_x = track->max_x > max_x ? track->max_x : max_x;
+        max_y = track->max_y > max_y ? track->max_y : max_y;
+    }
+
+    int zooms[] = {8, 11, 14, 17};
+    double total_seconds = 0;
+    long long total_tiles = 0;
+    for (int z = 0; z < (int)(sizeof(zooms) / sizeof(zooms[0])) && min_x <= max_x; z++)
+    {
+        int zoom = zooms[z];
+        int shift = MAX_ZOOM - zoom;
+        int first_x = (int)((min_x >> shift) / TILE_SIZE), last_x = (int)((max_x >> shift) / TILE_SIZE);
+        int first_y = (int)((min_y >> shift) / TILE_SIZE), last_y = (int)((max_y >> shift) / TILE_SIZE);
+
+        // a square of tiles in the middle, the whole area if it is small enough
+        int side = 1;
+        while ((side + 1) * (side + 1) <= BENCH_TILES_PER_ZOOM)
+            side++;
+        int center_x = (first_x + last_x) / 2, center_y = (first_y + last_y) / 2;
+        if (last_x - first_x + 1 > side)
+        {
+            first_x = center_x - side / 2;
+            last_x = first_x + side - 1;
+        }
+        if (last_y - first_y + 1 > side)
+        {
+            first_y = center_y - side / 2;
+            last_y = first_y + side - 1;
+        }
+
+        free_track_tile_cache(&collection->track_tile_cache);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int tiles = 0;
+        for (int y = first_y; y <= last_y; y++)
+        {
+            for (int x = first_x; x <= last_x; x++)
+            {
+                MapTile key = {.zoom = zoom, .tile_x = x, .tile_y = y};
+                get_or_render_track_tile(&appl, collection, key);
+                tiles++;
+            }
+        }
+        double seconds = bench_seconds_since(&start);
+
+        char name[32];
+        snprintf(name, sizeof(name), "tile_render_z%d", zoom);
+        bench_add(results, name, seconds, tiles, 1);
+        total_seconds += seconds;
+        total_tiles += tiles;
+    }
+    bench_add(results, "tile_render", total_seconds, total_tiles, 1);
+
+    free_track_tile_cache(&collection->track_tile_cache);
+    SDL_DestroyRenderer(appl.renderer);
+    SDL_FreeSurface(surface);
+    return true;
+}
+
+static bool bench_write_json(const char *path, const char *folder_path, const GpxCollection *collection, const BenchResults *results)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "{\n  \"folder\": \"");
+    for (const char *c = folder_path; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', f);
+        fputc(*c, f);
+    }
+    fprintf(f, "\",\n  \"tracks\": %d,\n  \"points\": %zu,\n  \"heat_samples\": %lld,\n  \"heat_threads\": %d,\n  \"max_heat\": %d,\n  \"stages\": [\n",
+            collection->total_tracks, collection->point_arena.count, bench_heat_samples(collection), heat_worker_count(), collection->max_heat);
+    for (int i = 0; i < results->count; i++)
+    {
+        const BenchStage *stage = &results->stages[i];
+        double seconds = stage->seconds / stage->repeat;
+        fprintf(f, "    {\"name\": \"%s\", \"seconds\": %.6f, \"items\": %lld, \"items_per_second\": %.1f, \"repeat\": %d}%s\n",
+                stage->name, seconds, stage->items, seconds > 0 ? stage->items / seconds : 0.0, stage->repeat,
+                i + 1 < results->count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    return ok;
+}
+
+static int bench_run(const char *folder_path, const char *output_path)
+{
+    GpxCollection collection = {0};
+    BenchResults results = {0};
+    struct timespec start;
+
+    // the track cache would skip the parser, every run imports all files
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!gpxParser_parse_all_files(&collection, folder_path, NULL, NULL))
+        return 1;
+    bench_add(&results, "parse", bench_seconds_since(&start), collection.point_arena.count, 1);
+
+    bench_project(&results, &collection);
+    bench_decode(&results, &collection);
+
+    reset_filters(&collection.filters);
+    apply_filter_values(&collection);
+
+    bool ok = bench_heat_index(&results, &collection);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ok = ok && calculate_heatmap(&collection);
+    bench_add(&results, "heat", bench_seconds_since(&start), bench_heat_samples(&collection), 1);
+
+    // same heat with the kd-tree, the grid is the default
+    heat_index = HEAT_INDEX_KDTREE;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ok = ok && calculate_heatmap(&collection);
+    bench_add(&results, "heat_kdtree", bench_seconds_since(&start), bench_heat_samples(&collection), 1);
+    heat_index = HEAT_INDEX_GRID;
+
+    ok = ok && bench_tiles(&results, &collection);
+    bench_filter_and_sort(&results, &collection);
+
+    ok = ok && bench_write_json(output_path, folder_path, &collection, &results);
+    if (ok)
+        printf("Wrote %s\n", output_path);
+
+    pointArena_free(&collection.point_arena);
+    trackPyramid_free(&collection.pyramid);
+    free(collection.tracks);
+    free(collection.list_order);
+    gpxParser_cleanup();
+    return ok ? 0 : 1;
+}
+
+static void bench_usage(const char *name)
+{
+    printf("usage: %s generate <folder> <tracks> <points per track> [seed]\n", name);
+    printf("       %s run <folder> [output.json]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 5 && strcmp(argv[1], "generate") == 0)
+    {
+        int tracks = atoi(argv[3]);
+        int points = atoi(argv[4]);
+        uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 42;
+        if (tracks <= 0 || points <= 0)
+        {
+            bench_usage(argv[0]);
+            return 1;
+        }
+        return corpus_generate(argv[2], tracks, points, seed) ? 0 : 1;
+    }
+    if (argc >= 3 && strcmp(argv[1], "run") == 0)
+    {
+        gpxParser_init();
+        return bench_run(argv[2], argc > 3 ? argv[3] : "pipeline_bench.json");
+    }
+
+    bench_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,521 @@
+#include "pointarena.h"
+
+// Grow a scratch buffer so it can hold at least count points. Old content is kept.
+bool pointBuffer_reserve(PointBuffer *buffer, int count)
+{
+    if (count <= buffer->capacity)
+        return true;
+
+    int new_capacity = buffer->capacity == 0 ? 1024 : buffer->capacity;
+    while (new_capacity < count)
+        new_capacity *= 2;
+
+    GpxPoint *temp = (GpxPoint *)realloc(buffer->points, new_capacity * sizeof(GpxPoint));
+    if (temp == NULL)
+    {
+        fprintf(stderr, "Memory reallocation for points failed.\n");
+        return false;
+    }
+    buffer->points = temp;
+    buffer->capacity = new_capacity;
+    return true;
+}
+
+void pointBuffer_free(PointBuffer *buffer)
+{
+    free(buffer->points);
+    buffer->points = NULL;
+    buffer->capacity = 0;
+}
+
+static bool pointArena_reserve(PointArena *arena, int count, size_t bytes)
+{
+    size_t old_bytes = arena->data_capacity + arena->capacity * sizeof(uint16_t);
+
+    if (arena->size + bytes > arena->data_capacity)
+    {
+        size_t new_capacity = arena->data_capacity == 0 ? 1 << 18 : arena->data_capacity;
+        while (new_capacity < arena->size + bytes)
+            new_capacity *= 2;
+        uint8_t *temp = (uint8_t *)realloc(arena->data, new_capacity);
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Memory reallocation for point arena failed.\n");
+            return false;
+        }
+        arena->data = temp;
+        arena->data_capacity = new_capacity;
+    }
+
+    if (arena->count + count > arena->capacity)
+    {
+        size_t new_capacity = arena->capacity == 0 ? 1 << 16 : arena->capacity;
+        while (new_capacity < arena->count + count)
+            new_capacity *= 2;
+        uint16_t *temp = (uint16_t *)realloc(arena->heat, new_capacity * sizeof(uint16_t));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Memory reallocation for point heat failed.\n");
+            return false;
+        }
+        arena->heat = temp;
+        arena->capacity = new_capacity;
+    }
+
+    memstat_resize(MEM_POINTS, old_bytes, arena->data_capacity + arena->capacity * sizeof(uint16_t));
+    return true;
+}
+
+static inline uint32_t pointArena_zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)-(int32_t)(delta >> 31);
+}
+
+static inline uint8_t *pointArena_put_varint(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Encode points for the arena into out, which needs room for POINT_ENCODED_BOUND(count) bytes.
+// The data starts with a PointBlock per POINT_BLOCK_SIZE points, followed by the points. Every field
+// is stored as the zigzag varint of its difference to the previous point of the block, like the
+// polyline encoding does with coordinates. The positions are already quantized to world pixels,
+// distance and elevation are quantized to decimeters and half meters. Returns the encoded size,
+// a multiple of 4 so the blocks of the next track stay aligned.
+size_t pointArena_encode(const GpxPoint *points, int count, uint8_t *out)
+{
+    PointBlock *blocks = (PointBlock *)out;
+    uint8_t *next = out + POINT_BLOCKS(count) * sizeof(PointBlock);
+    uint32_t last_x = 0, last_y = 0, last_distance = 0, last_elevation = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        PointBlock *block = &blocks[i / POINT_BLOCK_SIZE];
+        if (i % POINT_BLOCK_SIZE == 0)
+        {
+            block->offset = (uint32_t)(next - out);
+            block->min_x = block->max_x = points[i].world_x;
+            block->min_y = block->max_y = points[i].world_y;
+            last_x = last_y = last_distance = last_elevation = 0;
+        }
+        if (points[i].world_x < block->min_x)
+            block->min_x = points[i].world_x;
+        if (points[i].world_x > block->max_x)
+            block->max_x = points[i].world_x;
+        if (points[i].world_y < block->min_y)
+            block->min_y = points[i].world_y;
+        if (points[i].world_y > block->max_y)
+            block->max_y = points[i].world_y;
+
+        PointAttributes attributes = pointAttributes_pack(&points[i]);
+        uint32_t x = (uint32_t)points[i].world_x;
+        uint32_t y = (uint32_t)points[i].world_y;
+        uint32_t elevation = (uint32_t)(int32_t)attributes.elevation;
+
+        // differences wrap around in unsigned arithmetic, the decoder wraps back the same way
+        next = pointArena_put_varint(next, pointArena_zigzag(x - last_x));
+        next = pointArena_put_varint(next, pointArena_zigzag(y - last_y));
+        next = pointArena_put_varint(next, pointArena_zigzag(attributes.partial_distance - last_distance));
+        next = pointArena_put_varint(next, pointArena_zigzag(elevation - last_elevation));
+        last_x = x;
+        last_y = y;
+        last_distance = attributes.partial_distance;
+        last_elevation = elevation;
+    }
+    while ((next - out) % 4 != 0)
+        *next++ = 0;
+    return (size_t)(next - out);
+}
+
+// Encode the points of one track to the end of the arena. The arena may move, so tracks only
+// remember their offsets and get their pointers from pointArena_bind_tracks.
+bool pointArena_append(PointArena *arena, const GpxPoint *points, int count, GpxTrack *track)
+{
+    if (!pointArena_reserve(arena, count, POINT_ENCODED_BOUND(count)))
+        return false;
+
+    track->first_point = arena->count;
+    track->data_offset = arena->size;
+    track->data_size = pointArena_encode(points, count, &arena->data[arena->size]);
+    memset(&arena->heat[arena->count], 0, count * sizeof(uint16_t));
+    arena->size += track->data_size;
+    arena->count += count;
+    return true;
+}
+
+// Append points that were encoded by pointArena_encode, e.g. by a parser thread or in the track cache
+bool pointArena_append_encoded(PointArena *arena, const uint8_t *data, size_t size, int count, GpxTrack *track)
+{
+    if (!pointArena_reserve(arena, count, size))
+        return false;
+
+    track->first_point = arena->count;
+    track->data_offset = arena->size;
+    track->data_size = size;
+    memcpy(&arena->data[arena->size], data, size);
+    memset(&arena->heat[arena->count], 0, count * sizeof(uint16_t));
+    arena->size += size;
+    arena->count += count;
+    return true;
+}
+
+// Point every track at its range inside the arena
+void pointArena_bind_tracks(PointArena *arena, GpxTrack *tracks, int total_tracks)
+{
+    for (int i = 0; i < total_tracks; i++)
+    {
+        bool bound = tracks[i].total_points > 0;
+        tracks[i].points = NULL;
+        tracks[i].data = bound ? &arena->data[tracks[i].data_offset] : NULL;
+        tracks[i].heat = bound ? &arena->heat[tracks[i].first_point] : NULL;
+    }
+}
+
+// The track gives up its range, e.g. because its file changed. The space is counted as dead
+// until pointArena_compact reclaims it.
+void pointArena_release(PointArena *arena, GpxTrack *track)
+{
+    if (track->total_points <= 0)
+        return;
+    arena->dead_size += track->data_size;
+    arena->dead_count += track->total_points;
+    track->total_points = 0;
+    track->data_size = 0;
+    track->points = NULL;
+    track->data = NULL;
+    track->heat = NULL;
+}
+
+// Move the ranges of all tracks together once released ranges take up more than half of the
+// space in use. Decoded hot tracks are dropped since they are identified by their position.
+bool pointArena_compact(PointArena *arena, GpxTrack *tracks, int total_tracks)
+{
+    if (arena->dead_size <= (arena->size - arena->dead_size) / 2 && arena->dead_count <= (arena->count - arena->dead_count) / 2)
+        return true;
+
+    size_t live_size = 0;
+    size_t live_count = 0;
+    for (int i = 0; i < total_tracks; i++)
+    {
+        if (tracks[i].total_points > 0)
+        {
+            live_size += tracks[i].data_size;
+            live_count += tracks[i].total_points;
+        }
+    }
+
+    uint8_t *data = (uint8_t *)malloc(live_size > 0 ? live_size : 1);
+    uint16_t *heat = (uint16_t *)malloc((live_count > 0 ? live_count : 1) * sizeof(uint16_t));
+    if (!data || !heat)
+    {
+        // the arena stays as it is, nothing is lost
+        perror("malloc");
+        free(data);
+        free(heat);
+        return false;
+    }
+
+    size_t size = 0;
+    size_t count = 0;
+    for (int i = 0; i < total_tracks; i++)
+    {
+        GpxTrack *track = &tracks[i];
+        if (track->total_points <= 0)
+            continue;
+        memcpy(&data[size], &arena->data[track->data_offset], track->data_size);
+        memcpy(&heat[count], &arena->heat[track->first_point], track->total_points * sizeof(uint16_t));
+        track->data_offset = size;
+        track->first_point = count;
+        size += track->data_size;
+        count += track->total_points;
+    }
+
+    printf("Compacted point arena: %zu of %zu bytes in use\n", size, arena->size);
+    memstat_resize(MEM_POINTS, arena->data_capacity + arena->capacity * sizeof(uint16_t),
+                   (live_size > 0 ? live_size : 1) + (live_count > 0 ? live_count : 1) * sizeof(uint16_t));
+    free(arena->data);
+    free(arena->heat);
+    arena->data = data;
+    arena->heat = heat;
+    arena->size = size;
+    arena->data_capacity = live_size > 0 ? live_size : 1;
+    arena->count = count;
+    arena->capacity = live_count > 0 ? live_count : 1;
+    arena->dead_size = 0;
+    arena->dead_count = 0;
+    for (int i = 0; i < HOT_TRACK_SLOTS; i++)
+        arena->hot[i].count = 0;
+
+    pointArena_bind_tracks(arena, tracks, total_tracks);
+    return true;
+}
+
+static void hotTrack_free(HotTrack *hot)
+{
+    memstat_free(MEM_HOT_TRACKS, (size_t)hot->capacity * (2 * sizeof(int) + sizeof(PointAttributes)));
+    free(hot->world_x);
+    free(hot->world_y);
+    free(hot->attributes);
+    memset(hot, 0, sizeof(HotTrack));
+}
+
+// Decoded points of a track for random access, e.g. to draw its overlay or elevation profile.
+// The last HOT_TRACK_SLOTS tracks asked for stay decoded. Only call from the main thread, the
+// result is valid until the next call. Returns NULL if the memory for it is missing.
+const HotTrack *pointArena_hot_track(PointArena *arena, const GpxTrack *track)
+{
+    HotTrack *slot = &arena->hot[0];
+    for (int i = 0; i < HOT_TRACK_SLOTS; i++)
+    {
+        HotTrack *hot = &arena->hot[i];
+        if (hot->count > 0 && hot->first_point == track->first_point && hot->count == track->total_points)
+        {
+            hot->last_used = ++arena->hot_clock;
+            return hot;
+        }
+        if (hot->last_used < slot->last_used)
+            slot = hot;
+    }
+    if (track->total_points == 0 || !track->data)
+        return NULL;
+
+    if (slot->capacity < track->total_points)
+    {
+        hotTrack_free(slot);
+        slot->world_x = (int *)malloc(track->total_points * sizeof(int));
+        slot->world_y = (int *)malloc(track->total_points * sizeof(int));
+        slot->attributes = (PointAttributes *)malloc(track->total_points * sizeof(PointAttributes));
+        if (!slot->world_x || !slot->world_y || !slot->attributes)
+        {
+            perror("malloc");
+            free(slot->world_x);
+            free(slot->world_y);
+            free(slot->attributes);
+            memset(slot, 0, sizeof(HotTrack));
+            return NULL;
+        }
+        slot->capacity = track->total_points;
+        memstat_alloc(MEM_HOT_TRACKS, (size_t)slot->capacity * (2 * sizeof(int) + sizeof(PointAttributes)));
+    }
+
+    PointStream stream;
+    pointStream_init(&stream, track);
+    for (int i = 0; pointStream_next(&stream); i++)
+    {
+        slot->world_x[i] = stream.world_x;
+        slot->world_y[i] = stream.world_y;
+        slot->attributes[i].partial_distance = stream.partial_distance;
+        slot->attributes[i].elevation = (int16_t)stream.elevation;
+    }
+    slot->first_point = track->first_point;
+    slot->count = track->total_points;
+    slot->last_used = ++arena->hot_clock;
+    return slot;
+}
+
+void pointArena_free(PointArena *arena)
+{
+    for (int i = 0; i < HOT_TRACK_SLOTS; i++)
+        hotTrack_free(&arena->hot[i]);
+    memstat_free(MEM_POINTS, arena->data_capacity + arena->capacity * sizeof(uint16_t));
+    free(arena->data);
+    free(arena->heat);
+    arena->data = NULL;
+    arena->heat = NULL;
+    arena->size = 0;
+    arena->data_capacity = 0;
+    arena->count = 0;
+    arena->capacity = 0;
+    arena->hot_clock = 0;
+    arena->dead_size = 0;
+    arena->dead_count = 0;
+}
+
+void pointStream_init(PointStream *stream, const GpxTrack *track)
+{
+    stream->count = track->data ? track->total_points : 0;
+    stream->next = track->data ? track->data + POINT_BLOCKS(stream->count) * sizeof(PointBlock) : NULL;
+    stream->index = 0;
+    stream->world_x = 0;
+    stream->world_y = 0;
+    stream->partial_distance = 0;
+    stream->elevation = 0;
+}
+
+// Continue at the first point of a block, pointStream_next returns that point next
+void pointStream_seek(PointStream *stream, const GpxTrack *track, int block)
+{
+    const PointBlock *blocks = (const PointBlock *)track->data;
+    stream->next = track->data + blocks[block].offset;
+    stream->index = block * POINT_BLOCK_SIZE;
+}
+
+static inline uint32_t pointStream_delta(const uint8_t **next)
+{
+    const uint8_t *p = *next;
+    uint32_t value = *p & 0x7f;
+    int shift = 7;
+    while (*p++ & 0x80)
+    {
+        value |= (uint32_t)(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    *next = p;
+    return (value >> 1) ^ (uint32_t)-(int32_t)(value & 1);
+}
+
+// Step to the next point of the track, false after the last one
+bool pointStream_next(PointStream *stream)
+{
+    if (stream->index >= stream->count)
+        return false;
+    if (stream->index % POINT_BLOCK_SIZE == 0)
+    {
+        stream->world_x = 0;
+        stream->world_y = 0;
+        stream->partial_distance = 0;
+        stream->elevation = 0;
+    }
+    stream->index++;
+    stream->world_x = (int)((uint32_t)stream->world_x + pointStream_delta(&stream->next));
+    stream->world_y = (int)((uint32_t)stream->world_y + pointStream_delta(&stream->next));
+    stream->partial_distance += pointStream_delta(&stream->next);
+    stream->elevation = (int)((uint32_t)stream->elevation + pointStream_delta(&stream->next));
+    return true;
+}
+
+// Decode the positions of the points at indices, which have to be in ascending order.
+// indices NULL means the first count points.
+void pointStream_positions(const GpxTrack *track, const int *indices, int count, int *world_x, int *world_y)
+{
+    PointStream stream;
+    pointStream_init(&stream, track);
+    int index = 0;
+    for (int k = 0; k < count && pointStream_next(&stream); index++)
+    {
+        if (indices && indices[k] != index)
+            continue;
+        world_x[k] = stream.world_x;
+        world_y[k] = stream.world_y;
+        k++;
+    }
+}
+
+// Points of a track inside a box, level is a pyramid level or NULL for every point. Blocks
+// outside the box are not decoded at all.
+void pointQuery_init(PointQuery *query, const GpxTrack *track, const int *level, int level_count,
+                     int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y)
+{
+    pointStream_init(&query->stream, track);
+    query->track = track;
+    query->level = level;
+    query->level_count = query->stream.count > 0 ? level_count : 0;
+    query->k = 0;
+    query->block = -1;
+    query->min_x = min_x;
+    query->min_y = min_y;
+    query->max_x = max_x;
+    query->max_y = max_y;
+    query->index = -1;
+}
+
+// Step to the next point inside the box, its position is in query->stream and its index in
+// query->index. False when there are no more.
+bool pointQuery_next(PointQuery *query)
+{
+    const PointBlock *blocks = (const PointBlock *)query->track->data;
+
+    while (query->k < query->level_count)
+    {
+        int wanted = query->level ? query->level[query->k] : query->k;
+        int block = wanted / POINT_BLOCK_SIZE;
+        if (block != query->block)
+        {
+            const PointBlock *b = &blocks[block];
+            if (b->max_x < query->min_x || b->min_x > query->max_x || b->max_y < query->min_y || b->min_y > query->max_y)
+            {
+                int block_end = (block + 1) * POINT_BLOCK_SIZE;
+                while (query->k < query->level_count && (query->level ? query->level[query->k] : query->k) < block_end)
+                    query->k++;
+                continue;
+            }
+            if (block != query->stream.index / POINT_BLOCK_SIZE || query->stream.index > wanted)
+                pointStream_seek(&query->stream, query->track, block);
+            query->block = block;
+        }
+
+        while (query->stream.index <= wanted)
+            pointStream_next(&query->stream);
+        query->k++;
+
+        int x = query->stream.world_x;
+        int y = query->stream.world_y;
+        if (x >= query->min_x && x <= query->max_x && y >= query->min_y && y <= query->max_y)
+        {
+            query->index = wanted;
+            return true;
+        }
+    }
+    return false;
+}
+
+PointAttributes pointAttributes_pack(const GpxPoint *point)
+{
+    PointAttributes attributes;
+    float distance = point->partial_distance * POINT_DISTANCE_SCALE + 0.5f;
+    float elevation = point->elevation * POINT_ELEVATION_SCALE;
+    elevation = elevation < 0.0f ? elevation - 0.5f : elevation + 0.5f;
+
+    attributes.partial_distance = distance <= 0.0f ? 0 : distance >= (float)UINT32_MAX ? UINT32_MAX : (uint32_t)distance;
+    attributes.elevation = elevation <= INT16_MIN ? INT16_MIN : elevation >= INT16_MAX ? INT16_MAX : (int16_t)elevation;
+    return attributes;
+}
+
+float pointAttributes_elevation(const PointAttributes *attributes)
+{
+    return attributes->elevation / POINT_ELEVATION_SCALE;
+}
+
+float pointAttributes_distance(const PointAttributes *attributes)
+{
+    return attributes->partial_distance / POINT_DISTANCE_SCALE;
+}
+
+// Heat above POINT_MAX_HEAT would need that many tracks crossing one spot, it is capped
+uint16_t pointHeat_clamp(int heat)
+{
+    return heat < 0 ? 0 : heat > POINT_MAX_HEAT ? POINT_MAX_HEAT : (uint16_t)heat;
+}
+
+bool pointColumns_alloc(PointColumns *columns, int count)
+{
+    size_t n = count > 0 ? count : 1;
+    columns->world_x = (int *)malloc(n * sizeof(int));
+    columns->world_y = (int *)malloc(n * sizeof(int));
+    columns->track_id = (int *)malloc(n * sizeof(int));
+    columns->count = count;
+    if (!columns->world_x || !columns->world_y || !columns->track_id)
+    {
+        perror("malloc");
+        pointColumns_free(columns);
+        return false;
+    }
+    return true;
+}
+
+void pointColumns_free(PointColumns *columns)
+{
+    free(columns->world_x);
+    free(columns->world_y);
+    free(columns->track_id);
+    columns->world_x = NULL;
+    columns->world_y = NULL;
+    columns->track_id = NULL;
+    columns->count = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef pointarena_h
+#define pointarena_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "memstat.h"
+
+#define POINT_CODEC_VERSION 1 // layout of the encoded points, stored in the track cache
+#define POINT_ENCODED_BOUND(count) (POINT_BLOCKS(count) * sizeof(PointBlock) + (size_t)(count) * POINT_MAX_ENCODED_BYTES + 3)
+
+bool pointBuffer_reserve(PointBuffer *buffer, int count);
+void pointBuffer_free(PointBuffer *buffer);
+
+size_t pointArena_encode(const GpxPoint *points, int count, uint8_t *out);
+bool pointArena_append(PointArena *arena, const GpxPoint *points, int count, GpxTrack *track);
+bool pointArena_append_encoded(PointArena *arena, const uint8_t *data, size_t size, int count, GpxTrack *track);
+void pointArena_bind_tracks(PointArena *arena, GpxTrack *tracks, int total_tracks);
+void pointArena_release(PointArena *arena, GpxTrack *track);
+bool pointArena_compact(PointArena *arena, GpxTrack *tracks, int total_tracks);
+const HotTrack *pointArena_hot_track(PointArena *arena, const GpxTrack *track);
+void pointArena_free(PointArena *arena);
+
+void pointStream_init(PointStream *stream, const GpxTrack *track);
+void pointStream_seek(PointStream *stream, const GpxTrack *track, int block);
+bool pointStream_next(PointStream *stream);
+void pointStream_positions(const GpxTrack *track, const int *indices, int count, int *world_x, int *world_y);
+void pointQuery_init(PointQuery *query, const GpxTrack *track, const int *level, int level_count,
+                     int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y);
+bool pointQuery_next(PointQuery *query);
+
+PointAttributes pointAttributes_pack(const GpxPoint *point);
+float pointAttributes_elevation(const PointAttributes *attributes);
+float pointAttributes_distance(const PointAttributes *attributes);
+uint16_t pointHeat_clamp(int heat);
+
+bool pointColumns_alloc(PointColumns *columns, int count);
+void pointColumns_free(PointColumns *columns);
+
+#endif
@@ -0,0 +1,281 @@
+#include "pyramid.h"
+
+extern int heat_sample_spacing;
+
+// Simplified copies of every track for the zoom levels where one pixel covers several points.
+// A level keeps a point only if it is more than PYRAMID_TOLERANCE_PX pixels of that zoom away from
+// the last kept one (radial distance). Unlike Douglas-Peucker this never leaves long straight
+// stretches without points, the tile renderer draws dots and would show gaps there.
+//
+// The same arena holds the heat samples: the track thinned out to heat_sample_spacing, which also
+// collapses the pile of points a watch records while standing still into one. Heat is calculated
+// on the samples only and every raw point takes the heat of the last sample before it.
+
+static bool pyramidArena_reserve(PyramidArena *arena, size_t count)
+{
+    if (arena->count + count <= arena->capacity)
+        return true;
+
+    size_t new_capacity = arena->capacity == 0 ? 1 << 16 : arena->capacity;
+    while (new_capacity < arena->count + count)
+        new_capacity *= 2;
+
+    int *temp = (int *)realloc(arena->indices, new_capacity * sizeof(int));
+    if (temp == NULL)
+    {
+        fprintf(stderr, "Memory reallocation for track pyramid failed.\n");
+        return false;
+    }
+    memstat_resize(MEM_PYRAMID, arena->capacity * sizeof(int), new_capacity * sizeof(int));
+    arena->indices = temp;
+    arena->capacity = new_capacity;
+    return true;
+}
+
+// Thin out one level into the next coarser one, first and last point always stay
+static int trackPyramid_decimate(const int *world_x, const int *world_y, const int *source, int source_count, int64_t tolerance, int *out)
+{
+    if (source_count <= 2)
+    {
+        for (int i = 0; i < source_count; i++)
+            out[i] = source ? source[i] : i;
+        return source_count;
+    }
+
+    int64_t tolerance2 = tolerance * tolerance;
+    int first = source ? source[0] : 0;
+    int count = 0;
+    out[count++] = first;
+    int last = first;
+
+    for (int i = 1; i < source_count - 1; i++)
+    {
+        int index = source ? source[i] : i;
+        int64_t dx = world_x[index] - world_x[last];
+        int64_t dy = world_y[index] - world_y[last];
+        if (dx * dx + dy * dy > tolerance2)
+        {
+            out[count++] = index;
+            last = index;
+        }
+    }
+    out[count++] = source ? source[source_count - 1] : source_count - 1;
+    return count;
+}
+
+static bool trackPyramid_build_levels(PyramidArena *arena, GpxTrack *track, const int *world_x, const int *world_y)
+{
+    int n = track->total_points;
+
+    track->min_x = track->min_y = INT32_MAX;
+    track->max_x = track->max_y = INT32_MIN;
+    for (int i = 0; i < n; i++)
+    {
+        if (world_x[i] < track->min_x)
+            track->min_x = world_x[i];
+        if (world_x[i] > track->max_x)
+            track->max_x = world_x[i];
+        if (world_y[i] < track->min_y)
+            track->min_y = world_y[i];
+        if (world_y[i] > track->max_y)
+            track->max_y = world_y[i];
+    }
+
+    if (!pyramidArena_reserve(arena, n))
+    {
+        track->heat_count = 0;
+        memset(track->pyramid_count, 0, sizeof(track->pyramid_count));
+        return false;
+    }
+    int spacing = heat_sample_spacing > 0 ? heat_sample_spacing : 0;
+    track->heat_first = arena->count;
+    track->heat_count = trackPyramid_decimate(world_x, world_y, NULL, n, spacing, &arena->indices[arena->count]);
+    arena->count += track->heat_count;
+
+    // the finest level is derived from the raw points, every coarser level from the one above it
+    const int *source = NULL;
+    int source_count = n;
+    for (int level = PYRAMID_LEVELS - 1; level >= 0; level--)
+    {
+        if (!pyramidArena_reserve(arena, source_count))
+        {
+            track->heat_count = 0;
+            memset(track->pyramid_count, 0, sizeof(track->pyramid_count));
+            return false;
+        }
+
+        // reserve may have moved the arena, the source level has to be looked up again
+        if (level < PYRAMID_LEVELS - 1)
+            source = &arena->indices[track->pyramid_first[level + 1]];
+
+        int zoom = MIN_ZOOM + level;
+        int64_t tolerance = (int64_t)PYRAMID_TOLERANCE_PX << (MAX_ZOOM - zoom);
+        int *out = &arena->indices[arena->count];
+        track->pyramid_first[level] = arena->count;
+        track->pyramid_count[level] = trackPyramid_decimate(world_x, world_y, source, source_count, tolerance, out);
+        arena->count += track->pyramid_count[level];
+
+        source_count = track->pyramid_count[level];
+    }
+    return true;
+}
+
+// Bounding box and all zoom levels of one track, appended to the arena. The track's points are
+// decoded from the point arena once for this.
+bool trackPyramid_build(PyramidArena *arena, GpxTrack *track)
+{
+    int n = track->total_points > 0 ? track->total_points : 1;
+    int *world_x = (int *)malloc(n * sizeof(int));
+    int *world_y = (int *)malloc(n * sizeof(int));
+    bool ok = world_x && world_y;
+    if (ok)
+    {
+        pointStream_positions(track, NULL, track->total_points, world_x, world_y);
+        ok = trackPyramid_build_levels(arena, track, world_x, world_y);
+    }
+    else
+    {
+        perror("malloc");
+        track->heat_count = 0;
+        memset(track->pyramid_count, 0, sizeof(track->pyramid_count));
+    }
+    free(world_x);
+    free(world_y);
+    return ok;
+}
+
+bool trackPyramid_build_all(PyramidArena *arena, GpxTrack *tracks, int total_tracks)
+{
+    arena->count = 0;
+    arena->dead_count = 0;
+    for (int i = 0; i < total_tracks; i++)
+    {
+        if (!trackPyramid_build(arena, &tracks[i]))
+            return false;
+    }
+    printf("Track pyramid holds %zu points\n", arena->count);
+    return true;
+}
+
+// Point indices to draw a track with at a zoom level. Returns NULL if the raw points are needed,
+// count is set in both cases.
+const int *trackPyramid_level(const PyramidArena *arena, const GpxTrack *track, int zoom, int *count)
+{
+    if (zoom > PYRAMID_MAX_ZOOM || arena->indices == NULL)
+    {
+        *count = track->total_points;
+        return NULL;
+    }
+    if (zoom < MIN_ZOOM)
+        zoom = MIN_ZOOM;
+
+    int level = zoom - MIN_ZOOM;
+    *count = track->pyramid_count[level];
+    return &arena->indices[track->pyramid_first[level]];
+}
+
+// Point indices heat is calculated on, NULL if that is every raw point
+const int *trackPyramid_heat_samples(const PyramidArena *arena, const GpxTrack *track, int *count)
+{
+    if (arena->indices == NULL)
+    {
+        *count = track->total_points;
+        return NULL;
+    }
+    *count = track->heat_count;
+    return &arena->indices[track->heat_first];
+}
+
+// Give every raw point the heat of the sample it belongs to
+void trackPyramid_spread_heat(const PyramidArena *arena, GpxTrack *track)
+{
+    int count;
+    const int *samples = trackPyramid_heat_samples(arena, track, &count);
+    if (samples == NULL)
+        return;
+
+    for (int k = 0; k < count; k++)
+    {
+        int end = k + 1 < count ? samples[k + 1] : track->total_points;
+        uint16_t heat = track->heat[samples[k]];
+        for (int i = samples[k] + 1; i < end; i++)
+            track->heat[i] = heat;
+    }
+}
+
+bool trackPyramid_intersects(const GpxTrack *track, int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y)
+{
+    return track->total_points > 0 &&
+           track->max_x >= min_x && track->min_x <= max_x &&
+           track->max_y >= min_y && track->min_y <= max_y;
+}
+
+// The track gives up its levels and heat samples before it is removed or built again,
+// they are counted as dead until trackPyramid_compact reclaims them
+void trackPyramid_release(PyramidArena *arena, GpxTrack *track)
+{
+    arena->dead_count += track->heat_count;
+    track->heat_count = 0;
+    for (int level = 0; level < PYRAMID_LEVELS; level++)
+    {
+        arena->dead_count += track->pyramid_count[level];
+        track->pyramid_count[level] = 0;
+    }
+}
+
+// Move the levels and heat samples of all tracks together once released ones take up more
+// than half of the space in use
+bool trackPyramid_compact(PyramidArena *arena, GpxTrack *tracks, int total_tracks)
+{
+    if (arena->dead_count <= (arena->count - arena->dead_count) / 2)
+        return true;
+
+    size_t live = 0;
+    for (int i = 0; i < total_tracks; i++)
+    {
+        live += tracks[i].heat_count;
+        for (int level = 0; level < PYRAMID_LEVELS; level++)
+            live += tracks[i].pyramid_count[level];
+    }
+
+    int *indices = (int *)malloc((live > 0 ? live : 1) * sizeof(int));
+    if (!indices)
+    {
+        perror("malloc");
+        return false;
+    }
+
+    size_t count = 0;
+    for (int i = 0; i < total_tracks; i++)
+    {
+        GpxTrack *track = &tracks[i];
+        memcpy(&indices[count], &arena->indices[track->heat_first], track->heat_count * sizeof(int));
+        track->heat_first = count;
+        count += track->heat_count;
+        for (int level = 0; level < PYRAMID_LEVELS; level++)
+        {
+            memcpy(&indices[count], &arena->indices[track->pyramid_first[level]], track->pyramid_count[level] * sizeof(int));
+            track->pyramid_first[level] = count;
+            count += track->pyramid_count[level];
+        }
+    }
+
+    printf("Compacted track pyramid: %zu of %zu points in use\n", count, arena->count);
+    memstat_resize(MEM_PYRAMID, arena->capacity * sizeof(int), (live > 0 ? live : 1) * sizeof(int));
+    free(arena->indices);
+    arena->indices = indices;
+    arena->count = count;
+    arena->capacity = live > 0 ? live : 1;
+    arena->dead_count = 0;
+    return true;
+}
+
+void trackPyramid_free(PyramidArena *arena)
+{
+    memstat_free(MEM_PYRAMID, arena->capacity * sizeof(int));
+    free(arena->indices);
+    arena->indices = NULL;
+    arena->count = 0;
+    arena->capacity = 0;
+    arena->dead_count = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef pyramid_h
+#define pyramid_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "memstat.h"
+#include "pointarena.h"
+
+bool trackPyramid_build(PyramidArena *arena, GpxTrack *track);
+bool trackPyramid_build_all(PyramidArena *arena, GpxTrack *tracks, int total_tracks);
+const int *trackPyramid_level(const PyramidArena *arena, const GpxTrack *track, int zoom, int *count);
+const int *trackPyramid_heat_samples(const PyramidArena *arena, const GpxTrack *track, int *count);
+void trackPyramid_spread_heat(const PyramidArena *arena, GpxTrack *track);
+bool trackPyramid_intersects(const GpxTrack *track, int64_t min_x, int64_t min_y, int64_t max_x, int64_t max_y);
+void trackPyramid_release(PyramidArena *arena, GpxTrack *track);
+bool trackPyramid_compact(PyramidArena *arena, GpxTrack *tracks, int total_tracks);
+void trackPyramid_free(PyramidArena *arena);
+
+#endif
@@ -4,6 +4,8 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 #define M_PI 3.14159265358979323846
 #define TILE_SIZE 256
@@ -20,9 +22,13 @@
 #define FRAME_DELAY_MS (1000 / TARGET_FPS)
 #define INPUT_BUFFER_SIZE 16
 #define HEAT_BUCKETS 16
-#define NUM_THREADS 24
+#define HEAT_BATCH_POINTS 256 // points a heat worker takes at a time
 #define DEG_TO_RAD (M_PI / 180.0)
 #define METERS_PER_DEG_LAT 111320.0
+#define PYRAMID_MAX_ZOOM 14      // simplified tracks for MIN_ZOOM..PYRAMID_MAX_ZOOM, raw points above
+#define PYRAMID_LEVELS (PYRAMID_MAX_ZOOM - MIN_ZOOM + 1)
+#define PYRAMID_TOLERANCE_PX 1   // allowed deviation in pixels of the level's zoom
+#define HEAT_SAMPLE_SPACING 40   // default distance between the points heat is calculated on, world units at MAX_ZOOM
 
 typedef enum
 {
@@ -147,6 +153,55 @@ struct fifo
     pthread_cond_t cond;
 };
 
+// inotify watcher on the gpx folder, parses changed files in the background
+typedef struct
+{
+    const char *folder_path;
+    int inotify_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool running;
+    struct TrackUpdate *first_update; // parsed results waiting for the main thread
+    struct TrackUpdate *last_update;
+} FolderWatcher;
+
+// stages of a drawn frame shown in the performance HUD
+typedef enum
+{
+    PERF_EVENTS,
+    PERF_OVERLAY,
+    PERF_MAP_TILES,
+    PERF_TRACK_TILES,
+    PERF_CLAY_LAYOUT,
+    PERF_CLAY_RENDER,
+    PERF_PRESENT,
+    PERF_FRAME,
+    PERF_STAGE_COUNT,
+} PerfStage;
+
+typedef struct
+{
+    float last_ms;
+    float avg_ms;  // moving average over the drawn frames
+    float peak_ms; // slowest frame of the last second
+    float window_peak_ms;
+} PerfStageStats;
+
+typedef struct
+{
+    bool show_hud;
+    PerfStageStats stages[PERF_STAGE_COUNT];
+    double current_ms[PERF_STAGE_COUNT]; // frame being drawn
+    Uint32 window_start;                 // start of the current one second window
+    int presented_frames;
+    int tile_hits; // lookups in the current window
+    int tile_misses;
+    int track_tile_hits;
+    int track_tile_misses;
+    float tile_hit_rate; // of the last full window, -1 without lookups
+    float track_tile_hit_rate;
+} PerfStats;
+
 struct application
 {
     SDL_Window *window;
@@ -177,6 +232,8 @@ struct application
     bool mouseOverUI;
     bool show_heat;
     bool update_window;
+    FolderWatcher gpx_watcher;
+    PerfStats perf;
 };
 
 typedef struct GpxPoint
@@ -199,16 +256,139 @@ typedef enum
     Other,
 } ActivityType;
 
-typedef struct GpxTrack
+typedef struct
 {
     GpxPoint *points;
+    int capacity;
+} PointBuffer; // reusable scratch space a parser collects the points of one track in
+
+#define POINT_ELEVATION_SCALE 2.0f // PointAttributes.elevation is in half meters
+#define POINT_DISTANCE_SCALE 10.0f // PointAttributes.partial_distance is in decimeters
+#define POINT_MAX_HEAT UINT16_MAX
+#define POINT_MAX_ENCODED_BYTES 20 // four varints of up to 5 bytes
+#define POINT_BLOCK_SIZE 64        // points per independently decodable block
+#define POINT_BLOCKS(count) (((count) + POINT_BLOCK_SIZE - 1) / POINT_BLOCK_SIZE)
+#define HOT_TRACK_SLOTS 8
+
+// Distance and elevation of a decoded point, quantized the same way the arena stores them
+typedef struct
+{
+    uint32_t partial_distance; // decimeters since the start of the track
+    int16_t elevation;         // half meters
+} PointAttributes;
+
+// A track decoded from the point arena for code that needs random access to its points
+typedef struct
+{
+    size_t first_point; // identifies the track, ranges only move in pointArena_compact which clears all slots
+    int count;          // 0 for a free slot
+    uint64_t last_used;
+    int *world_x;
+    int *world_y;
+    PointAttributes *attributes;
+    int capacity;
+} HotTrack;
+
+// Bounding box and start of POINT_BLOCK_SIZE points of a track. A track's encoded data begins with
+// one of these per block, a block's first point is not a delta so decoding can start there.
+typedef struct
+{
+    uint32_t offset; // from the start of the track's data
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+} PointBlock;
+
+// Points of all tracks after the import. Positions, distance and elevation are stored per track as
+// zigzag varint deltas to the previous point, only the heat stays uncompressed since it changes.
+typedef struct
+{
+    uint8_t *data; // encoded points, each track owns the bytes from data_offset
+    size_t size;
+    size_t data_capacity;
+    uint16_t *heat; // heat of every point, each track owns the range from first_point
+    size_t count;
+    size_t capacity;
+    HotTrack hot[HOT_TRACK_SLOTS]; // the least recently used decoded track is replaced first
+    uint64_t hot_clock;
+    size_t dead_size;  // bytes and points of removed or replaced tracks, reclaimed by pointArena_compact
+    size_t dead_count;
+} PointArena;
+
+// Reads the encoded points of a track one after the other, see pointStream_next
+typedef struct
+{
+    const uint8_t *next;
+    int index; // of the next point
+    int count;
+    int world_x;
+    int world_y;
+    uint32_t partial_distance; // decimeters, like PointAttributes
+    int elevation;             // half meters
+} PointStream;
+
+// Points of a track or of one of its pyramid levels inside a box, blocks outside are skipped
+typedef struct
+{
+    PointStream stream;
+    const struct GpxTrack *track;
+    const int *level; // NULL for every point
+    int level_count;
+    int k;     // next entry of level
+    int block; // block the stream is in, -1 before the first
+    int64_t min_x;
+    int64_t min_y;
+    int64_t max_x;
+    int64_t max_y;
+    int index; // point index of the last point returned
+} PointQuery;
+
+// Positions and track ids of a set of points, one array per field
+typedef struct
+{
+    int *world_x;
+    int *world_y;
+    int *track_id;
+    int count;
+} PointColumns;
+
+typedef struct
+{
+    int *indices; // point indices of the simplified tracks, per track and zoom level one range
+    size_t count;
+    size_t capacity;
+    size_t dead_count; // indices of removed or rebuilt tracks, reclaimed by trackPyramid_compact
+} PyramidArena;
+
+typedef struct GpxTrack
+{
+    GpxPoint *points; // only while parsing, NULL once the points are in the arena
+    const uint8_t *data; // &arena.data[data_offset], refreshed by pointArena_bind_tracks
+    uint16_t *heat;      // &arena.heat[first_point]
+    size_t data_offset;
+    size_t data_size;
+    size_t first_point;
     int total_points;
     int track_id;
     int mid_x;
     int mid_y;
+    int min_x; // bounding box in world coordinates
+    int min_y;
+    int max_x;
+    int max_y;
+    size_t pyramid_first[PYRAMID_LEVELS]; // simplified track per zoom level in the PyramidArena
+    int pyramid_count[PYRAMID_LEVELS];
+    size_t heat_first; // resampled points the heat is calculated on, also in the PyramidArena
+    int heat_count;
     ActivityType act_type; // Original ISO8601 string from first <trkpt>
 
     bool visible_in_list;
+    bool removed; // source file was deleted while running, the empty slot keeps track ids stable
+
+    char source_name[256]; // File name inside the gpx folder, "<archive>/<member>" for zip members
+    int64_t source_size;   // Size of the source file when it was parsed
+    int64_t source_mtime;  // Modification time of the source file in ns, CRC-32 for zip members
 
     char start_time_raw[64]; // Original ISO8601 string from first <trkpt>
     char end_time_raw[64];   // Original ISO8601 string from last <trkpt>
@@ -292,11 +472,22 @@ typedef struct FilterSettings
 
 } FilterSettings;
 
+// All tracks of one entry of the gpx folder after it was added, changed or removed
+typedef struct TrackUpdate
+{
+    char file_name[256];
+    GpxTrack *tracks; // each owns its points, none if the file is gone
+    int total_tracks;
+    struct TrackUpdate *next;
+} TrackUpdate;
+
 typedef struct GpxCollection
 {
     GpxTrack *tracks;
     int total_tracks;
-    char total_visible_tracks_str[32];
+    PointArena point_arena;
+    PyramidArena pyramid;
+    char total_visible_tracks_str[48]; // "Shown: %d of %d Tracks" with two full ints
     int max_heat;
     AttributeType current_sorting;
     AttributeType to_be_sorted_by;
@@ -305,26 +496,253 @@ typedef struct GpxCollection
     TrackTileTextureCache track_tile_cache;
 } GpxCollection;
 
-typedef struct KDNode
+
+// Neighbour index the heat is calculated with, -heatindex
+typedef enum
+{
+    HEAT_INDEX_GRID,
+    HEAT_INDEX_KDTREE,
+} HeatIndex;
+
+// Copy of a heat sample in the order of a neighbour index
+typedef struct
+{
+    int world_x;
+    int world_y;
+    int track_id;
+    int point; // index into the PointColumns the index was built from
+} HeatSample;
+
+typedef struct
+{
+    uint64_t key; // cell_y << 32 | cell_x
+    int first;    // first point of the cell, the cell ends where the next one starts
+} HeatGridCell;
+
+// Uniform grid over the heat samples with cells at least HEAT_RADIUS wide after the x correction,
+// so every neighbour of a point is in the 3x3 cells around it. Points are stored by cell, rows
+// from top to bottom and cells of a row from left to right, empty cells are left out.
+typedef struct
 {
-    GpxPoint *point;
-    int axis;
-    struct KDNode *left, *right;
-} KDNode;
+    HeatSample *points;
+    HeatGridCell *cells; // cell_count cells and an end marker whose first is point_count
+    int point_count;
+    int cell_count;
+    int min_x;
+    int min_y;
+    int cell_w;
+    int cell_h;
+} HeatGrid;
+
+#define KD_LEAF_SIZE 32  // points a leaf of the kd-tree holds at most
+#define KD_STACK_SIZE 64 // pending ranges of a query, twice the depth of any tree that fits an int
+
+// kd-tree without nodes: the points are ordered so that the range [lo, hi) of a node splits at
+// its middle point mid, on x at even and on y at odd depths. [lo, mid) and [mid + 1, hi) are the
+// children, ranges of KD_LEAF_SIZE or fewer points are leaves. Read-only once built, any number of threads can query it.
+typedef struct
+{
+    HeatSample *points;
+    int count;
+} KdTree;
 
 typedef struct
 {
-    GpxPoint **points;
-    int start;
-    int end;
-    KDNode *tree;
+    int lo;
+    int hi;
+    int depth;
+} KdRange;
+
+// Points of a kd-tree inside a box, walked with an explicit stack
+typedef struct
+{
+    const KdTree *tree;
+    int64_t min_x;
+    int64_t min_y;
+    int64_t max_x;
+    int64_t max_y;
+    KdRange stack[KD_STACK_SIZE];
+    int top;
+    int leaf; // next point of the current leaf
+    int leaf_end;
+    int index; // point index of the last point returned
+} KdQuery;
+
+typedef struct
+{
+    const PointColumns *points;
+    atomic_int *heat; // result per point, written as soon as it is known
+    atomic_int *next_item; // shared by all workers, points of the kd-tree or cells of the grid
+    int total_items;
+    int batch_size; // items taken from next_item at a time
+    const KdTree *tree;
+    const HeatGrid *grid; // used instead of the tree when set
     float radius2;
     int total_tracks;
-    int *thread_max_heat;
-    pthread_mutex_t *max_mutex;
-    pthread_mutex_t *progress_mutex;
-    int thread_progress;
-    int *total_progress;
+    int max_heat;                // of this worker, set when it is done
+    atomic_int *total_progress;  // points done by all workers, added after each batch
+    atomic_int *completed;       // log of the finished points, may be NULL
+    atomic_int *completed_tail;  // entries of completed reserved so far, one range per batch
+    atomic_bool *cancel;         // stop taking batches when set, may be NULL
+    pthread_mutex_t *done_mutex; // guards running_workers
+    pthread_cond_t *done_cond;   // signalled by every worker that is done
+    int *running_workers;
 } HeatmapTask;
 
+// Reusable byte buffer, archive entries are decompressed into it
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} ByteBuffer;
+
+// Location of one member inside a zip archive, taken from the central directory
+typedef struct
+{
+    uint64_t local_header_offset;
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+    uint32_t crc;
+    uint16_t method; // 0 = stored, 8 = deflate
+} ArchiveEntry;
+
+// A zip archive mapped read-only for the whole import, shared by all workers
+typedef struct
+{
+    char *file_name;
+    const unsigned char *data;
+    size_t size;
+} ZipArchive;
+
+// One track to import: a plain or gzip file of the folder, or a zip archive member
+typedef struct
+{
+    char *name;   // file name, "<archive>/<member>" for zip members; also the track cache key
+    int archive;  // index into the zip archives, -1 for files
+    ArchiveEntry entry;
+} IngestSource;
+
+typedef enum
+{
+    LOAD_IDLE,
+    LOAD_PARSING,
+    LOAD_PARSED,
+    LOAD_HEAT,
+    LOAD_DONE,
+} LoadStage;
+
+// Progress of the background import and heat calculation, written by the workers, shown by the UI
+typedef struct
+{
+    atomic_int stage; // LoadStage
+    atomic_int done;
+    atomic_int total;
+    atomic_bool cancel; // set by loader_stop, the import and heat workers stop at the next file or batch
+} LoadProgress;
+
+// Heat calculation on a snapshot of the visible points, so the main thread can keep drawing
+typedef struct
+{
+    PointColumns points; // positions of the visible heat samples, only the heat threads touch them
+    size_t *arena_index; // where each sample came from in the point arena
+    atomic_int *heat;    // result per copy, -1 until it is calculated
+    atomic_int *completed; // indices of the copies in the order they were finished, -1 until then
+    int applied;           // entries of completed already copied back
+    bool *track_changed;   // per track id, scratch of heatJob_apply
+    int *changed_tracks;   // tracks with new heat in this heatJob_apply
+    int total_points;
+    int total_tracks;
+    int max_heat;
+    int seen_max_heat; // of the values copied back so far
+    atomic_bool finished;
+    LoadProgress *progress;
+    pthread_t thread;
+} HeatJob;
+
+typedef struct
+{
+    LoadProgress progress;
+    GpxCollection staging; // filled by the import thread, handed to the main thread when done
+    HeatJob heat;
+    pthread_t thread;
+    Uint32 last_refresh;
+} Loader;
+
+typedef struct
+{
+    IngestSource *sources;
+    int count;
+    int capacity;
+    ZipArchive *archives;
+    int archive_count;
+} IngestSourceList;
+
+typedef struct
+{
+    const char *folder_path;
+    IngestSource *sources;
+    int total_files;
+    ZipArchive *archives;
+    GpxTrack *tracks; // one slot per source, index == position in sources
+    bool *parsed;
+    bool *skipped; // the parser rejected the source, or the track cache says it did last time
+    int *next_file;
+    pthread_mutex_t *next_file_mutex;
+    PointArena *arena;
+    pthread_mutex_t *arena_mutex;
+    LoadProgress *progress; // may be NULL
+} IngestTask;
+
+// Where the fields the FIT decoder cares about sit inside one local message type
+typedef struct
+{
+    bool defined;
+    bool big_endian;
+    uint16_t global_message;
+    int message_size; // bytes of one data message, developer fields included
+    int timestamp_offset;
+    int timestamp_size;
+    int lat_offset;
+    int lat_size;
+    int lon_offset;
+    int lon_size;
+    int altitude_offset;
+    int altitude_size;
+    int enhanced_altitude_offset;
+    int enhanced_altitude_size;
+    int sport_offset;
+    int sport_size;
+} FitDefinition;
+
+#define TRACK_CACHE_MAGIC 0x43545046 // "FPTC"
+#define TRACK_CACHE_VERSION 6
+#define TRACK_CACHE_SKIPPED 0x1 // the source did not yield a track, it is not parsed again until it changes
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t track_size; // sizeof(GpxTrack) of the writer, guards against layout changes
+    uint32_t point_codec; // POINT_CODEC_VERSION of the writer
+    uint32_t entry_count;
+    uint32_t reserved;
+} TrackCacheHeader;
+
+typedef struct
+{
+    uint64_t points_offset; // byte offset of the track's encoded points, data_size bytes long
+    uint32_t flags;         // TRACK_CACHE_SKIPPED
+    uint32_t reserved;
+    GpxTrack track;         // pointers are meaningless on disk, only the source fields are set for skipped entries
+} TrackCacheEntry;
+
+typedef struct
+{
+    void *data;
+    size_t size;
+    const TrackCacheEntry *entries; // sorted by track.source_name
+    uint32_t entry_count;
+} TrackCache;
+
 #endif
\ No newline at end of file
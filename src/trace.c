@@ -0,0 +1,238 @@
+#include "trace.h"
+
+// Timeline of the import, heat, tile and frame stages for chrome://tracing or ui.perfetto.dev.
+// Every thread records complete events ("ph":"X") into its own ring buffer, trace_dump writes
+// all buffers as Chrome trace JSON. Nothing is recorded unless trace_start was called.
+
+static atomic_bool trace_on = false;
+static char trace_output_path[1024];
+static uint64_t trace_origin_ns;
+
+static pthread_mutex_t trace_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *trace_buffers = NULL;
+static char trace_thread_names[TRACE_MAX_THREADS][32];
+static atomic_int trace_next_tid = 1;
+static pthread_key_t trace_buffer_key;
+
+static __thread TraceBuffer *trace_local = NULL;
+static __thread int trace_tid = 0;
+
+static uint64_t trace_clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// Runs when a thread with a buffer exits, its events stay until the buffer is reused
+static void trace_release_buffer(void *arg)
+{
+    TraceBuffer *buffer = (TraceBuffer *)arg;
+    pthread_mutex_lock(&trace_registry_lock);
+    buffer->in_use = false;
+    pthread_mutex_unlock(&trace_registry_lock);
+}
+
+static int trace_thread_id(void)
+{
+    if (trace_tid == 0)
+        trace_tid = atomic_fetch_add(&trace_next_tid, 1);
+    return trace_tid;
+}
+
+static TraceBuffer *trace_thread_buffer(void)
+{
+    if (trace_local)
+        return trace_local;
+
+    pthread_mutex_lock(&trace_registry_lock);
+    TraceBuffer *buffer = trace_buffers;
+    while (buffer && buffer->in_use)
+        buffer = buffer->next;
+    if (!buffer)
+    {
+        buffer = (TraceBuffer *)calloc(1, sizeof(TraceBuffer));
+        if (!buffer)
+        {
+            pthread_mutex_unlock(&trace_registry_lock);
+            perror("calloc");
+            return NULL;
+        }
+        pthread_mutex_init(&buffer->lock, NULL);
+        buffer->next = trace_buffers;
+        trace_buffers = buffer;
+    }
+    buffer->in_use = true;
+    pthread_mutex_unlock(&trace_registry_lock);
+
+    pthread_setspecific(trace_buffer_key, buffer);
+    trace_local = buffer;
+    return buffer;
+}
+
+// Start recording, trace_shutdown writes the timeline to output_path
+bool trace_start(const char *output_path)
+{
+    if (pthread_key_create(&trace_buffer_key, trace_release_buffer) != 0)
+    {
+        perror("pthread_key_create");
+        return false;
+    }
+    snprintf(trace_output_path, sizeof(trace_output_path), "%s", output_path);
+    trace_origin_ns = trace_clock_ns();
+    atomic_store(&trace_on, true);
+    trace_set_thread_name("main");
+    return true;
+}
+
+bool trace_enabled(void)
+{
+    return atomic_load_explicit(&trace_on, memory_order_relaxed);
+}
+
+// Name of the calling thread in the timeline
+void trace_set_thread_name(const char *name)
+{
+    if (!trace_enabled())
+        return;
+    int tid = trace_thread_id();
+    if (tid >= TRACE_MAX_THREADS)
+        return;
+    pthread_mutex_lock(&trace_registry_lock);
+    snprintf(trace_thread_names[tid], sizeof(trace_thread_names[tid]), "%s", name);
+    pthread_mutex_unlock(&trace_registry_lock);
+}
+
+// Start time for trace_end, 0 while tracing is off
+uint64_t trace_begin(void)
+{
+    if (!trace_enabled())
+        return 0;
+    return trace_clock_ns();
+}
+
+// Record an event from start until now, name has to be a string literal
+void trace_end(const char *name, const char *detail, uint64_t start)
+{
+    if (start == 0 || !trace_enabled())
+        return;
+    uint64_t end = trace_clock_ns();
+    TraceBuffer *buffer = trace_thread_buffer();
+    if (!buffer)
+        return;
+
+    pthread_mutex_lock(&buffer->lock);
+    TraceEvent *e = &buffer->events[buffer->written % TRACE_BUFFER_EVENTS];
+    e->name = name;
+    e->tid = trace_thread_id();
+    e->start_ns = start;
+    e->duration_ns = end - start;
+    snprintf(e->detail, sizeof(e->detail), "%s", detail ? detail : "");
+    buffer->written++;
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+TraceScope trace_scope_begin(const char *name)
+{
+    TraceScope scope = {name, trace_begin()};
+    return scope;
+}
+
+void trace_scope_end(TraceScope *scope)
+{
+    trace_end(scope->name, NULL, scope->start);
+}
+
+static void trace_write_json_string(FILE *f, const char *text)
+{
+    fputc('"', f);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(f, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(f, "\\u%04x", *c);
+        else
+            fputc(*c, f);
+    }
+    fputc('"', f);
+}
+
+static void trace_write_event(FILE *f, const TraceEvent *e, bool *first)
+{
+    // timestamps are microseconds since trace_start
+    double ts = e->start_ns >= trace_origin_ns ? (e->start_ns - trace_origin_ns) / 1000.0 : 0.0;
+    fprintf(f, "%s\n{\"name\":", *first ? "" : ",");
+    trace_write_json_string(f, e->name);
+    fprintf(f, ",\"cat\":\"footprints\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", e->tid, ts, e->duration_ns / 1000.0);
+    if (e->detail[0])
+    {
+        fprintf(f, ",\"args\":{\"detail\":");
+        trace_write_json_string(f, e->detail);
+        fputc('}', f);
+    }
+    fputc('}', f);
+    *first = false;
+}
+
+// Write everything recorded so far to the output path, recording goes on
+bool trace_dump(void)
+{
+    if (!trace_enabled())
+        return false;
+
+    FILE *f = fopen(trace_output_path, "w");
+    if (!f)
+    {
+        perror(trace_output_path);
+        return false;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    size_t total_events = 0;
+
+    pthread_mutex_lock(&trace_registry_lock);
+    int total_tids = atomic_load(&trace_next_tid);
+    for (int tid = 1; tid < total_tids && tid < TRACE_MAX_THREADS; tid++)
+    {
+        if (!trace_thread_names[tid][0])
+            continue;
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",", tid);
+        trace_write_json_string(f, trace_thread_names[tid]);
+        fprintf(f, "}}");
+        first = false;
+    }
+
+    for (TraceBuffer *buffer = trace_buffers; buffer; buffer = buffer->next)
+    {
+        pthread_mutex_lock(&buffer->lock);
+        // oldest first, a full ring starts at the write position
+        uint64_t count = buffer->written < TRACE_BUFFER_EVENTS ? buffer->written : TRACE_BUFFER_EVENTS;
+        for (uint64_t i = buffer->written - count; i < buffer->written; i++)
+            trace_write_event(f, &buffer->events[i % TRACE_BUFFER_EVENTS], &first);
+        total_events += count;
+        pthread_mutex_unlock(&buffer->lock);
+    }
+    pthread_mutex_unlock(&trace_registry_lock);
+
+    fprintf(f, "\n]}\n");
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    if (ok)
+        printf("Wrote %zu trace events to %s\n", total_events, trace_output_path);
+    else
+        fprintf(stderr, "Failed to write %s\n", trace_output_path);
+    return ok;
+}
+
+// Write the trace and stop recording. The buffers are not freed, the detached download
+// thread may still be inside trace_end.
+void trace_shutdown(void)
+{
+    if (!trace_enabled())
+        return;
+    trace_dump();
+    atomic_store(&trace_on, false);
+}
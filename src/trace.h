@@ -0,0 +1,60 @@
+#ifndef trace_h
+#define trace_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#define TRACE_BUFFER_EVENTS 8192 // per thread, the oldest events are overwritten
+#define TRACE_DETAIL_LENGTH 48   // file name, tile or chunk of an event, cut off if longer
+#define TRACE_MAX_THREADS 256    // threads with a name in the timeline
+
+typedef struct
+{
+    const char *name; // string literal, events only keep the pointer
+    int tid;
+    char detail[TRACE_DETAIL_LENGTH];
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} TraceEvent;
+
+// Ring buffer of one thread. Only the owner writes, the lock is for dumps while it runs.
+// Buffers of finished threads are handed to the next new thread.
+typedef struct TraceBuffer
+{
+    pthread_mutex_t lock;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    uint64_t written;
+    bool in_use;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+// Scope of TRACE_SCOPE, ends when the variable goes out of scope
+typedef struct
+{
+    const char *name;
+    uint64_t start;
+} TraceScope;
+
+bool trace_start(const char *output_path);
+bool trace_enabled(void);
+void trace_set_thread_name(const char *name);
+uint64_t trace_begin(void);
+void trace_end(const char *name, const char *detail, uint64_t start);
+bool trace_dump(void);
+void trace_shutdown(void);
+
+TraceScope trace_scope_begin(const char *name);
+void trace_scope_end(TraceScope *scope);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(trace_scope_end))) = trace_scope_begin(name)
+
+#endif
@@ -0,0 +1,216 @@
+#include "trackcache.h"
+
+bool trackCache_stat_source(const char *path, int64_t *size, int64_t *mtime)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    *size = (int64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Strings of an entry are used as they are on disk, a damaged file must not make them run past the field
+static bool trackCache_entry_valid(const TrackCacheEntry *entry)
+{
+    const GpxTrack *track = &entry->track;
+    return memchr(track->source_name, 0, sizeof(track->source_name)) &&
+           memchr(track->start_time_raw, 0, sizeof(track->start_time_raw)) &&
+           memchr(track->end_time_raw, 0, sizeof(track->end_time_raw));
+}
+
+// Map the cache file into memory. A missing or outdated cache is not an error,
+// the cache is simply empty then and every file goes through the parser.
+bool trackCache_open(TrackCache *cache, const char *path)
+{
+    cache->data = NULL;
+    cache->size = 0;
+    cache->entries = NULL;
+    cache->entry_count = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TrackCacheHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    const TrackCacheHeader *header = (const TrackCacheHeader *)data;
+    size_t entries_end = sizeof(TrackCacheHeader) + (size_t)header->entry_count * sizeof(TrackCacheEntry);
+    if (header->magic != TRACK_CACHE_MAGIC || header->version != TRACK_CACHE_VERSION ||
+        header->track_size != sizeof(GpxTrack) || header->point_codec != POINT_CODEC_VERSION ||
+        entries_end > (size_t)st.st_size)
+    {
+        printf("Ignoring outdated track cache %s\n", path);
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    const TrackCacheEntry *entries = (const TrackCacheEntry *)((const char *)data + sizeof(TrackCacheHeader));
+    for (uint32_t i = 0; i < header->entry_count; i++)
+    {
+        if (!trackCache_entry_valid(&entries[i]))
+        {
+            fprintf(stderr, "Ignoring damaged track cache %s\n", path);
+            munmap(data, st.st_size);
+            return false;
+        }
+    }
+
+    cache->data = data;
+    cache->size = st.st_size;
+    cache->entries = entries;
+    cache->entry_count = header->entry_count;
+    printf("Track cache holds %u entries\n", cache->entry_count);
+    return true;
+}
+
+// Copy a cached track into *track and its points into the arena if the source file
+// did not change since it was cached. *skipped is set when the cached result is that the
+// source yields no track, *track and the arena are left alone then.
+bool trackCache_lookup(TrackCache *cache, const char *source_name, int64_t source_size, int64_t source_mtime, GpxTrack *track, PointArena *arena, bool *skipped)
+{
+    *skipped = false;
+    int low = 0;
+    int high = (int)cache->entry_count - 1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        const TrackCacheEntry *entry = &cache->entries[mid];
+        int cmp = strcmp(source_name, entry->track.source_name);
+        if (cmp < 0)
+        {
+            high = mid - 1;
+            continue;
+        }
+        if (cmp > 0)
+        {
+            low = mid + 1;
+            continue;
+        }
+
+        if (entry->track.source_size != source_size || entry->track.source_mtime != source_mtime)
+            return false;
+
+        if (entry->flags & TRACK_CACHE_SKIPPED)
+        {
+            *skipped = true;
+            return true;
+        }
+
+        if (entry->points_offset > cache->size || entry->track.data_size > cache->size - entry->points_offset)
+            return false;
+
+        // the points are cached in the encoding of the arena and copied as they are
+        GpxTrack restored = entry->track;
+        const uint8_t *data = (const uint8_t *)cache->data + entry->points_offset;
+        if (!pointArena_append_encoded(arena, data, entry->track.data_size, entry->track.total_points, &restored))
+            return false;
+
+        *track = restored;
+        track->points = NULL;
+        track->data = NULL;
+        track->heat = NULL;
+        return true;
+    }
+    return false;
+}
+
+void trackCache_close(TrackCache *cache)
+{
+    if (cache->data)
+        munmap(cache->data, cache->size);
+    cache->data = NULL;
+    cache->size = 0;
+    cache->entries = NULL;
+    cache->entry_count = 0;
+}
+
+static bool trackCache_write_entry(FILE *f, const GpxTrack *track, uint32_t flags, uint64_t points_offset)
+{
+    TrackCacheEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.points_offset = points_offset;
+    entry.flags = flags;
+    entry.track = *track;
+    entry.track.points = NULL;
+    entry.track.data = NULL;
+    entry.track.heat = NULL;
+    return fwrite(&entry, sizeof(entry), 1, f) == 1;
+}
+
+// Write all tracks and the sources that yielded none to a temporary file and move it over the old
+// cache in one step. Both lists have to be sorted by source_name, which is the order they are parsed in,
+// tracks have to be bound to the point arena. Of skipped only the source fields are stored.
+bool trackCache_write(const char *path, GpxTrack *tracks, int total_tracks, GpxTrack *skipped, int total_skipped)
+{
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f)
+    {
+        perror("fopen");
+        return false;
+    }
+
+    int total_entries = total_tracks + total_skipped;
+    TrackCacheHeader header = {
+        .magic = TRACK_CACHE_MAGIC,
+        .version = TRACK_CACHE_VERSION,
+        .track_size = sizeof(GpxTrack),
+        .point_codec = POINT_CODEC_VERSION,
+        .entry_count = (uint32_t)total_entries,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    // merge both lists so the entries stay sorted for the binary search in trackCache_lookup
+    uint64_t points_offset = sizeof(TrackCacheHeader) + (uint64_t)total_entries * sizeof(TrackCacheEntry);
+    int t = 0;
+    int s = 0;
+    while (ok && (t < total_tracks || s < total_skipped))
+    {
+        if (s >= total_skipped || (t < total_tracks && strcmp(tracks[t].source_name, skipped[s].source_name) < 0))
+        {
+            ok = trackCache_write_entry(f, &tracks[t], 0, points_offset);
+            points_offset += tracks[t].data_size;
+            t++;
+        }
+        else
+        {
+            ok = trackCache_write_entry(f, &skipped[s], TRACK_CACHE_SKIPPED, 0);
+            s++;
+        }
+    }
+
+    for (int i = 0; ok && i < total_tracks; i++)
+    {
+        if (tracks[i].data_size > 0)
+            ok = fwrite(tracks[i].data, 1, tracks[i].data_size, f) == tracks[i].data_size;
+    }
+
+    if (fclose(f) != 0)
+        ok = false;
+
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Failed to write track cache %s\n", path);
+        remove(tmp_path);
+        return false;
+    }
+    printf("Wrote %d tracks and %d skipped files to track cache %s\n", total_tracks, total_skipped, path);
+    return true;
+}
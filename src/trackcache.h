@@ -0,0 +1,22 @@
+#ifndef trackcache_h
+#define trackcache_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "structs.h"
+#include "pointarena.h"
+
+#define TRACK_CACHE_PATH "trackcache.bin"
+
+bool trackCache_open(TrackCache *cache, const char *path);
+bool trackCache_lookup(TrackCache *cache, const char *source_name, int64_t source_size, int64_t source_mtime, GpxTrack *track, PointArena *arena, bool *skipped);
+void trackCache_close(TrackCache *cache);
+bool trackCache_write(const char *path, GpxTrack *tracks, int total_tracks, GpxTrack *skipped, int total_skipped);
+bool trackCache_stat_source(const char *path, int64_t *size, int64_t *mtime);
+
+#endif
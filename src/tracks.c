@@ -151,7 +151,10 @@ void free_track_tile_cache(TrackTileTextureCache *cache)
     for (int i = 0; i < cache->size; i++)
     {
         if (cache->entries[i].texture)
+        {
+            memstat_remove_texture(MEM_TRACK_TILES, cache->entries[i].texture);
             SDL_DestroyTexture(cache->entries[i].texture);
+        }
     }
     free(cache->entries);
     cache->entries = NULL;
@@ -159,6 +162,37 @@ void free_track_tile_cache(TrackTileTextureCache *cache)
     cache->capacity = 0;
 }
 
+// Drop the cached track tiles that overlap a rectangle in world coordinates (MAX_ZOOM),
+// the next frame renders them again. Each tile is widened by half a point square in world
+// units of its zoom, so points drawn at its edge count as well.
+void invalidate_track_tiles(TrackTileTextureCache *cache, int min_x, int min_y, int max_x, int max_y)
+{
+    int i = 0;
+    while (i < cache->size)
+    {
+        MapTile key = cache->entries[i].key;
+        int shift = MAX_ZOOM - key.zoom;
+        int64_t stroke = (int64_t)(TRACK_POINT_SIZE_PX / 2) << shift;
+        int64_t tile_min_x = ((int64_t)key.tile_x * TILE_SIZE << shift) - stroke;
+        int64_t tile_min_y = ((int64_t)key.tile_y * TILE_SIZE << shift) - stroke;
+        int64_t tile_max_x = ((int64_t)(key.tile_x + 1) * TILE_SIZE << shift) - 1 + stroke;
+        int64_t tile_max_y = ((int64_t)(key.tile_y + 1) * TILE_SIZE << shift) - 1 + stroke;
+
+        if (tile_max_x < min_x || tile_min_x > max_x || tile_max_y < min_y || tile_min_y > max_y)
+        {
+            i++;
+            continue;
+        }
+
+        if (cache->entries[i].texture)
+        {
+            memstat_remove_texture(MEM_TRACK_TILES, cache->entries[i].texture);
+            SDL_DestroyTexture(cache->entries[i].texture);
+        }
+        cache->entries[i] = cache->entries[--cache->size];
+    }
+}
+
 SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *collection, MapTile key)
 {
     // Check if already cached
@@ -166,9 +200,12 @@ SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *c
     {
         if (tile_key_equal(collection->track_tile_cache.entries[i].key, key))
         {
+            appl->perf.track_tile_hits++;
             return collection->track_tile_cache.entries[i].texture;
         }
     }
+    appl->perf.track_tile_misses++;
+    TRACE_SCOPE("track tile render");
 
     // Collect all points
     CombinedTilePoints ctp = {
@@ -177,32 +214,41 @@ SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *c
         .point_count = 0,
         .capacity = 0};
 
+    // world coordinates (MAX_ZOOM) covered by this tile
+    int shift = MAX_ZOOM - key.zoom;
+    int64_t tile_min_x = (int64_t)key.tile_x * TILE_SIZE << shift;
+    int64_t tile_min_y = (int64_t)key.tile_y * TILE_SIZE << shift;
+    int64_t tile_max_x = ((int64_t)(key.tile_x + 1) * TILE_SIZE << shift) - 1;
+    int64_t tile_max_y = ((int64_t)(key.tile_y + 1) * TILE_SIZE << shift) - 1;
+
     for (int t = 0; t < collection->total_tracks; t++)
     {
         if (collection->tracks[t].visible_in_list)
         {
             GpxTrack *track = &collection->tracks[t];
-            for (int i = 0; i < track->total_points; i++)
+            if (!trackPyramid_intersects(track, tile_min_x, tile_min_y, tile_max_x, tile_max_y))
+                continue;
+
+            // points closer than a pixel of this zoom level are left out. The encoded points are
+            // streamed block by block, blocks outside the tile are skipped without decoding them.
+            int level_count;
+            const int *level = trackPyramid_level(&collection->pyramid, track, key.zoom, &level_count);
+            PointQuery query;
+            pointQuery_init(&query, track, level, level_count, tile_min_x, tile_min_y, tile_max_x, tile_max_y);
+            while (pointQuery_next(&query))
             {
-                int world_x = track->points[i].world_x;
-                int world_y = track->points[i].world_y;
-                int tile_x, tile_y, pixel_in_tile_x, pixel_in_tile_y;
-                conv_pixel_to_tile_and_offset(world_x, world_y, MAX_ZOOM, key.zoom, &tile_x, &tile_y, &pixel_in_tile_x, &pixel_in_tile_y);
-
-                if (tile_x == key.tile_x && tile_y == key.tile_y)
+                int world_x = query.stream.world_x;
+                int world_y = query.stream.world_y;
+                if (ctp.point_count >= ctp.capacity)
                 {
-
-                    if (ctp.point_count >= ctp.capacity)
-                    {
-                        ctp.capacity = ctp.capacity == 0 ? 16 : ctp.capacity * 2;
-                        ctp.points = realloc(ctp.points, ctp.capacity * sizeof(HeatPoint));
-                    }
-                    HeatPoint hp = {
-                        .pos = {pixel_in_tile_x, pixel_in_tile_y},
-                        .heat = track->points[i].heat};
-
-                    ctp.points[ctp.point_count++] = hp;
+                    ctp.capacity = ctp.capacity == 0 ? 16 : ctp.capacity * 2;
+                    ctp.points = realloc(ctp.points, ctp.capacity * sizeof(HeatPoint));
                 }
+                HeatPoint hp = {
+                    .pos = {(int)((world_x - tile_min_x) >> shift), (int)((world_y - tile_min_y) >> shift)},
+                    .heat = track->heat[query.index]};
+
+                ctp.points[ctp.point_count++] = hp;
             }
         }
     }
@@ -213,6 +259,7 @@ SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *c
         free(ctp.points);
         return NULL;
     }
+    memstat_add_texture(MEM_TRACK_TILES, tex);
 
     SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
     SDL_SetRenderTarget(appl->renderer, tex);
@@ -242,9 +289,9 @@ SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *c
         SDL_SetRenderDrawColor(appl->renderer, color.r, color.g, color.b, color.a);
 
         SDL_Rect rct = {
-            ctp.points[j].pos.x - 2,
-            ctp.points[j].pos.y - 2,
-            4, 4};
+            ctp.points[j].pos.x - TRACK_POINT_SIZE_PX / 2,
+            ctp.points[j].pos.y - TRACK_POINT_SIZE_PX / 2,
+            TRACK_POINT_SIZE_PX, TRACK_POINT_SIZE_PX};
         SDL_RenderFillRect(appl->renderer, &rct);
     }
 
@@ -271,13 +318,18 @@ int find_track_near_click(GpxCollection *collection, int click_world_x, int clic
         if (collection->tracks[i].visible_in_list)
         {
             GpxTrack *track = &collection->tracks[i];
-
-            for (int j = 0; j < track->total_points; j++)
+            int64_t margin = (int64_t)max_pixel_distance << (MAX_ZOOM - current_zoom);
+            if (!trackPyramid_intersects(track, click_world_x - margin, click_world_y - margin, click_world_x + margin, click_world_y + margin))
+                continue;
+
+            int level_count;
+            const int *level = trackPyramid_level(&collection->pyramid, track, current_zoom, &level_count);
+            PointQuery query;
+            pointQuery_init(&query, track, level, level_count, click_world_x - margin, click_world_y - margin, click_world_x + margin, click_world_y + margin);
+            while (pointQuery_next(&query))
             {
-                GpxPoint *pt = &track->points[j];
-
-                int64_t dx = (pt->world_x - click_world_x) >> (MAX_ZOOM - current_zoom);
-                int64_t dy = (pt->world_y - click_world_y) >> (MAX_ZOOM - current_zoom);
+                int64_t dx = (query.stream.world_x - click_world_x) >> (MAX_ZOOM - current_zoom);
+                int64_t dy = (query.stream.world_y - click_world_y) >> (MAX_ZOOM - current_zoom);
                 int64_t dist_squared = dx * dx + dy * dy;
 
                 if (0 < dist_squared && dist_squared < closest_distance_squared)
@@ -298,6 +350,7 @@ void update_selected_track_overlay(struct application *appl, GpxCollection *coll
     {
         if (appl->selected_track_overlay[zoom])
         {
+            memstat_remove_texture(MEM_OVERLAYS, appl->selected_track_overlay[zoom]);
             SDL_DestroyTexture(appl->selected_track_overlay[zoom]);
             appl->selected_track_overlay[zoom] = NULL;
         }
@@ -307,6 +360,7 @@ void update_selected_track_overlay(struct application *appl, GpxCollection *coll
     // destroy old texture
     if (appl->selected_track_overlay[zoom])
     {
+        memstat_remove_texture(MEM_OVERLAYS, appl->selected_track_overlay[zoom]);
         SDL_DestroyTexture(appl->selected_track_overlay[zoom]);
         appl->selected_track_overlay[zoom] = NULL;
     }
@@ -323,6 +377,7 @@ void update_selected_track_overlay(struct application *appl, GpxCollection *coll
         SDL_Log("Fehler beim Erstellen der Overlay-Textur: %s", SDL_GetError());
         return;
     }
+    memstat_add_texture(MEM_OVERLAYS, overlay);
 
     SDL_SetTextureBlendMode(overlay, SDL_BLENDMODE_BLEND);
     SDL_SetRenderTarget(appl->renderer, overlay);
@@ -344,16 +399,29 @@ void update_selected_track_overlay(struct application *appl, GpxCollection *coll
     if (!track)
         return;
 
+    // the selected track is drawn at every zoom level, it stays decoded while it is selected
+    const HotTrack *points = pointArena_hot_track(&collection->point_arena, track);
+    if (!points)
+    {
+        SDL_SetRenderTarget(appl->renderer, NULL);
+        appl->selected_track_overlay[zoom] = overlay;
+        return;
+    }
+
     int zoom_factor = 1 << (MAX_ZOOM - zoom);
 
-    SDL_Point pts[track->total_points];
-    for (int i = 0; i < track->total_points; i++)
+    int level_count;
+    const int *level = trackPyramid_level(&collection->pyramid, track, zoom, &level_count);
+
+    SDL_Point pts[level_count > 0 ? level_count : 1];
+    for (int k = 0; k < level_count; k++)
     {
-        pts[i].x = ((track->points[i].world_x - appl->world_x) / zoom_factor) + (appl->window_width / 2);
-        pts[i].y = ((track->points[i].world_y - appl->world_y) / zoom_factor) + (appl->window_height / 2);
+        int i = level ? level[k] : k;
+        pts[k].x = ((points->world_x[i] - appl->world_x) / zoom_factor) + (appl->window_width / 2);
+        pts[k].y = ((points->world_y[i] - appl->world_y) / zoom_factor) + (appl->window_height / 2);
     }
     SDL_Color color = {.a = 255, .r = 255, .g = 255, .b = 0};
-    draw_smooth_thick_polyline(appl->renderer, pts, track->total_points, 10.0f, color);
+    draw_smooth_thick_polyline(appl->renderer, pts, level_count, 10.0f, color);
 
     // Switch back to normal render target
     SDL_SetRenderTarget(appl->renderer, NULL);
@@ -361,11 +429,15 @@ void update_selected_track_overlay(struct application *appl, GpxCollection *coll
     appl->selected_track_overlay[zoom] = overlay;
 }
 
-SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const GpxTrack track, int width, int height)
+SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, PointArena *arena, const GpxTrack track, int width, int height)
 {
     if (!renderer || track.total_points < 2)
         return NULL;
 
+    const HotTrack *points = pointArena_hot_track(arena, &track);
+    if (!points)
+        return NULL;
+
     SDL_Texture *texture = SDL_CreateTexture(renderer,
                                              SDL_PIXELFORMAT_RGBA8888,
                                              SDL_TEXTUREACCESS_TARGET,
@@ -383,14 +455,16 @@ SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const Gp
     SDL_RenderClear(renderer);
 
     // Calculate min and max height plus some margin
-    float min_elev = track.points[0].elevation;
-    float max_elev = track.points[0].elevation;
+    const PointAttributes *attributes = points->attributes;
+    float min_elev = pointAttributes_elevation(&attributes[0]);
+    float max_elev = min_elev;
     for (int i = 1; i < track.total_points; i++)
     {
-        if (track.points[i].elevation < min_elev)
-            min_elev = track.points[i].elevation;
-        if (track.points[i].elevation > max_elev)
-            max_elev = track.points[i].elevation;
+        float elevation = pointAttributes_elevation(&attributes[i]);
+        if (elevation < min_elev)
+            min_elev = elevation;
+        if (elevation > max_elev)
+            max_elev = elevation;
     }
     if (max_elev == min_elev)
         max_elev += 1.0f;
@@ -398,7 +472,7 @@ SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const Gp
     min_elev -= (max_elev - min_elev)/10;
     max_elev += (max_elev - min_elev)/10;
 
-    float total_distance_m = track.points[track.total_points - 1].partial_distance;
+    float total_distance_m = pointAttributes_distance(&attributes[track.total_points - 1]);
 
     // Prepare points for polygon
     SDL_Point *polygon_points = malloc(sizeof(SDL_Point) * (track.total_points + 2));
@@ -411,8 +485,8 @@ SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const Gp
 
     for (int i = 0; i < track.total_points; i++)
     {
-        int x = (int)((track.points[i].partial_distance / total_distance_m) * width);
-        int y = height - (int)(((track.points[i].elevation - min_elev) / (max_elev - min_elev)) * height);
+        int x = (int)((pointAttributes_distance(&attributes[i]) / total_distance_m) * width);
+        int y = height - (int)(((pointAttributes_elevation(&attributes[i]) - min_elev) / (max_elev - min_elev)) * height);
         polygon_points[i] = (SDL_Point){x, y};
     }
 
@@ -425,10 +499,10 @@ SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const Gp
 
     for (int i = 1; i < track.total_points; i++)
     {
-        int x1 = (int)((track.points[i - 1].partial_distance / total_distance_m) * width);
-        int y1 = height - (int)(((track.points[i - 1].elevation - min_elev) / (max_elev - min_elev)) * height);
-        int x2 = (int)((track.points[i].partial_distance / total_distance_m) * width);
-        int y2 = height - (int)(((track.points[i].elevation - min_elev) / (max_elev - min_elev)) * height);
+        int x1 = (int)((pointAttributes_distance(&attributes[i - 1]) / total_distance_m) * width);
+        int y1 = height - (int)(((pointAttributes_elevation(&attributes[i - 1]) - min_elev) / (max_elev - min_elev)) * height);
+        int x2 = (int)((pointAttributes_distance(&attributes[i]) / total_distance_m) * width);
+        int y2 = height - (int)(((pointAttributes_elevation(&attributes[i]) - min_elev) / (max_elev - min_elev)) * height);
 
         // Fill area underneath two points tirangle + quad
         for (int x = x1; x <= x2; x++)
@@ -448,7 +522,7 @@ SDL_Texture *generate_elevation_profile_texture(SDL_Renderer *renderer, const Gp
     return texture;
 }
 
-void save_elevation_profile_as_png(SDL_Renderer *renderer, const GpxTrack track, const char *filepath, int width, int height)
+void save_elevation_profile_as_png(SDL_Renderer *renderer, PointArena *arena, const GpxTrack track, const char *filepath, int width, int height)
 {
     // Create a target texture (RGBA)
     SDL_Texture *target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
@@ -467,7 +541,7 @@ void save_elevation_profile_as_png(SDL_Renderer *renderer, const GpxTrack track,
     SDL_RenderClear(renderer);
 
     // Draw the profile into the current render target (your existing function)
-    SDL_Texture *profile_tex = generate_elevation_profile_texture(renderer, track, width, height);
+    SDL_Texture *profile_tex = generate_elevation_profile_texture(renderer, arena, track, width, height);
     SDL_RenderCopy(renderer, profile_tex, NULL, NULL);
     SDL_DestroyTexture(profile_tex);
 
@@ -496,11 +570,11 @@ void save_elevation_profile_as_png(SDL_Renderer *renderer, const GpxTrack track,
     SDL_DestroyTexture(target);
 }
 
-void update_track_info_graphs(struct application *appl, GpxCollection collection)
+void update_track_info_graphs(struct application *appl, GpxCollection *collection)
 {
   static int prev_selected_track = -1;
   if (appl->selected_track >= 0 && prev_selected_track != appl->selected_track)
   {
-    save_elevation_profile_as_png(appl->renderer, collection.tracks[appl->selected_track], "resources/elev_profile.png", 200, 100);
+    save_elevation_profile_as_png(appl->renderer, &collection->point_arena, collection->tracks[appl->selected_track], "resources/elev_profile.png", 200, 100);
   }
 }
\ No newline at end of file
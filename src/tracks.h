@@ -9,9 +9,16 @@
 #include <SDL2/SDL.h>
 #include "structs.h"
 #include "map.h"
+#include "pyramid.h"
+#include "pointarena.h"
+#include "trace.h"
+#include "memstat.h"
+
+#define TRACK_POINT_SIZE_PX 4 // points are drawn as squares of this size on the track tiles
 
 void free_track_tile_cache(TrackTileTextureCache *cache);
-void update_track_info_graphs(struct application *appl, GpxCollection collection);
+void invalidate_track_tiles(TrackTileTextureCache *cache, int min_x, int min_y, int max_x, int max_y);
+void update_track_info_graphs(struct application *appl, GpxCollection *collection);
 SDL_Texture *get_or_render_track_tile(struct application *appl, GpxCollection *collection, MapTile key);
 int find_track_near_click(GpxCollection *collection, int click_x, int click_y, int current_zoom, int max_pixel_distance);
 void update_selected_track_overlay(struct application *appl, GpxCollection *collection);
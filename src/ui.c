@@ -13,6 +13,7 @@
 #define MENU_ICON_SIZE 32 + 2 * GAPS
 
 #define ELEMENTS_HEIGHT 30
+#define PERF_HUD_WIDTH 300
 #define ELEMENTS_WIDTH 180
 #define LIST_ENTRY_HEIGHT 30
 #define HEADER_HEIGHT 50
@@ -35,6 +36,7 @@
 #define STATISTICS 4
 
 extern SDL_Event event;
+extern Loader loader;
 
 UIState ui = {
     .left_sidebar = {.opening = false, .closing = false, .animation = 0, .ticks = 0},
@@ -653,16 +655,14 @@ void clicked_calculate_heat(
     {
         GpxCollection *collection = (GpxCollection *)userData;
 
+        // still importing or calculating
+        if (loader_busy(&loader))
+            return;
+
         // reset heat for all points
-        for (int track = 0; track < collection->total_tracks; track++)
-        {
-            for (int pt = 0; pt < collection->tracks[track].total_points; pt++)
-            {
-                collection->tracks[track].points[pt].heat = 0;
-            }
-        }
-        // recalculate heat
-        calculate_heatmap(collection);
+        memset(collection->point_arena.heat, 0, collection->point_arena.count * sizeof(uint16_t));
+        // recalculate heat in the background, the map shows the results as they come in
+        loader_start_heat(&loader, collection);
         free_track_tile_cache(&collection->track_tile_cache);
     }
 }
@@ -928,6 +928,8 @@ void clay_init(struct application *appl)
     clayMemory = (Clay_Arena){
         .memory = malloc(clayRequiredMemory),
         .capacity = clayRequiredMemory};
+    if (clayMemory.memory)
+        memstat_alloc(MEM_CLAY, clayRequiredMemory);
 
     Clay_Initialize(
         clayMemory,
@@ -938,6 +940,8 @@ void clay_init(struct application *appl)
 
 void clay_free_memory()
 {
+    if (clayMemory.memory)
+        memstat_free(MEM_CLAY, clayMemory.capacity);
     free(clayMemory.memory);
     clayMemory.memory = NULL;
     clayMemory.capacity = 0;
@@ -1052,8 +1056,124 @@ void draw_sidebar_track_info(SDL_Surface *icon, char *value, char *unit, int id)
     }
 }
 
+// Import and heat progress at the bottom of the window while the loader is busy
+void draw_load_progress(struct application *appl)
+{
+    int stage = atomic_load(&loader.progress.stage);
+    if (stage != LOAD_PARSING && stage != LOAD_PARSED && stage != LOAD_HEAT)
+        return;
+
+    int done = atomic_load(&loader.progress.done);
+    int total = atomic_load(&loader.progress.total);
+    float fraction = total > 0 ? (float)done / total : 0.0f;
+    if (fraction > 1.0f)
+        fraction = 1.0f;
+
+    static char progress_label[64];
+    if (stage == LOAD_HEAT)
+        snprintf(progress_label, sizeof(progress_label), "Calculating heat: %d%%", (int)(fraction * 100));
+    else
+        snprintf(progress_label, sizeof(progress_label), "Importing tracks: %d / %d", done, total);
+
+    CLAY(CLAY_ID("LoadProgress"),
+         {.floating = {
+              .attachTo = CLAY_ATTACH_TO_ROOT,
+              .offset = {
+                  .x = (appl->window_width - MENU_BAR_WIDTH) / 2,
+                  .y = appl->window_height - SCREEN_BORDER_PADDING - 2 * ELEMENTS_HEIGHT},
+          },
+          .layout = {.padding = CLAY_PADDING_ALL(GAPS), .childGap = GAPS, .sizing = {.width = CLAY_SIZING_FIXED(MENU_BAR_WIDTH), .height = CLAY_SIZING_FIT()}, .layoutDirection = CLAY_TOP_TO_BOTTOM},
+          .backgroundColor = bg,
+          .cornerRadius = CORNER_RADIUS})
+    {
+        draw_clay_text(progress_label, 16, fg, CLAY_TEXT_ALIGN_CENTER);
+        CLAY(CLAY_ID("LoadProgressTrack"),
+             {.layout = {.sizing = {.width = CLAY_SIZING_GROW(0), .height = CLAY_SIZING_FIXED(6)}},
+              .backgroundColor = bg_d,
+              .cornerRadius = CLAY_CORNER_RADIUS(3)})
+        {
+            CLAY(CLAY_ID("LoadProgressBar"),
+                 {.layout = {.sizing = {.width = CLAY_SIZING_FIXED(fraction * (MENU_BAR_WIDTH - 2 * GAPS)), .height = CLAY_SIZING_GROW(0)}},
+                  .backgroundColor = darkAqua,
+                  .cornerRadius = CLAY_CORNER_RADIUS(3)})
+            {
+            }
+        }
+    }
+}
+
+static void format_hit_rate(char *out, size_t size, const char *name, int cached, float hit_rate)
+{
+    if (hit_rate < 0.0f)
+        snprintf(out, size, "%s: %d cached, no lookups", name, cached);
+    else
+        snprintf(out, size, "%s: %d cached, %d%% hits", name, cached, (int)(hit_rate * 100.0f + 0.5f));
+}
+
+// Frame timings, cache statistics and memory per subsystem, toggled with F3
+void draw_perf_hud(struct application *appl, GpxCollection *collection)
+{
+    if (!appl->perf.show_hud)
+        return;
+
+    static char lines[PERF_STAGE_COUNT + MEM_TAG_COUNT + 6][96];
+    int count = 0;
+
+    snprintf(lines[count++], sizeof(lines[0]), "FPS: %d   (ms last / avg / peak)", appl->currentFPS);
+    for (int i = 0; i < PERF_STAGE_COUNT; i++)
+    {
+        PerfStageStats *stats = &appl->perf.stages[i];
+        snprintf(lines[count++], sizeof(lines[0]), "%s: %.2f / %.2f / %.2f",
+                 perf_stage_name(i), stats->last_ms, stats->avg_ms, stats->peak_ms);
+    }
+    format_hit_rate(lines[count++], sizeof(lines[0]), "Map tiles", appl->tile_cache.size, appl->perf.tile_hit_rate);
+    format_hit_rate(lines[count++], sizeof(lines[0]), "Track tiles", collection->track_tile_cache.size, appl->perf.track_tile_hit_rate);
+
+    pthread_mutex_lock(&appl->download_queue.lock);
+    int queued = fifo_depth(&appl->download_queue);
+    pthread_mutex_unlock(&appl->download_queue.lock);
+    snprintf(lines[count++], sizeof(lines[0]), "Download queue: %d", queued);
+
+    memstat_sample_tracks(collection);
+    size_t cpu_total = 0, gpu_total = 0;
+    for (int i = 0; i < MEM_TAG_COUNT; i++)
+    {
+        size_t bytes;
+        int allocations;
+        char formatted[32];
+        memstat_get(i, &bytes, &allocations);
+        memstat_format_bytes(formatted, sizeof(formatted), bytes);
+        snprintf(lines[count++], sizeof(lines[0]), "%s: %s (%d)", memstat_tag_name(i), formatted, allocations);
+        if (memstat_is_gpu(i))
+            gpu_total += bytes;
+        else
+            cpu_total += bytes;
+    }
+    char cpu_formatted[32], gpu_formatted[32];
+    memstat_format_bytes(cpu_formatted, sizeof(cpu_formatted), cpu_total);
+    memstat_format_bytes(gpu_formatted, sizeof(gpu_formatted), gpu_total);
+    snprintf(lines[count++], sizeof(lines[0]), "Memory: %s CPU, %s GPU", cpu_formatted, gpu_formatted);
+
+    CLAY(CLAY_ID("PerfHud"),
+         {.floating = {
+              .attachTo = CLAY_ATTACH_TO_ROOT,
+              .attachPoints = {.element = CLAY_ATTACH_POINT_LEFT_BOTTOM, .parent = CLAY_ATTACH_POINT_LEFT_BOTTOM},
+              .offset = {.x = SCREEN_BORDER_PADDING, .y = -SCREEN_BORDER_PADDING},
+          },
+          .layout = {.padding = CLAY_PADDING_ALL(GAPS), .sizing = {.width = CLAY_SIZING_FIXED(PERF_HUD_WIDTH), .height = CLAY_SIZING_FIT()}, .layoutDirection = CLAY_TOP_TO_BOTTOM},
+          .backgroundColor = bg,
+          .cornerRadius = CORNER_RADIUS})
+    {
+        for (int i = 0; i < count; i++)
+            draw_clay_text(lines[i], 14, fg, CLAY_TEXT_ALIGN_LEFT);
+    }
+}
+
 void clay_draw_UI(struct application *appl, GpxCollection *collection)
 {
+    TRACE_SCOPE("ui");
+    Uint64 layout_start = perf_now();
+
     if (!clayMemory.memory)
     {
         fprintf(stderr, "[CLAY] ERROR: clayMemory not initialized!\n");
@@ -1280,7 +1400,14 @@ void clay_draw_UI(struct application *appl, GpxCollection *collection)
         draw_run_list_bottom(collection->total_visible_tracks_str, collection);
     }
 
+    draw_load_progress(appl);
+    draw_perf_hud(appl, collection);
+
     Clay_RenderCommandArray ui_renderCommands = Clay_EndLayout();
+    perf_add(&appl->perf, PERF_CLAY_LAYOUT, layout_start);
+
+    Uint64 render_start = perf_now();
     Clay_SDL2_Render(appl->renderer, ui_renderCommands, appl->fonts);
+    perf_add(&appl->perf, PERF_CLAY_RENDER, render_start);
     // end UI
 }
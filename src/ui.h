@@ -14,10 +14,16 @@
 #include "tracks.h"
 #include "heat.h"
 #include "filters.h"
+#include "loader.h"
+#include "perf.h"
+#include "trace.h"
+#include "memstat.h"
+#include "fifo.h"
 
 float get_delta_time(Uint32 lastFrameTime);
 void clay_init(struct application *appl);
 void clay_draw_UI(struct application *appl, GpxCollection* collection);
 void clay_free_memory();
+void sort_tracks_by(GpxCollection *collection, AttributeType criteria);
 
 #endif
\ No newline at end of file
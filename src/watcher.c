@@ -0,0 +1,335 @@
+#include "watcher.h"
+
+extern int heat_sample_spacing;
+
+// The watcher thread only parses. Merging into the collection, heat and tile cache
+// happens on the main thread in watcher_apply_updates, nothing else touches them.
+
+static bool watcher_is_running(FolderWatcher *watcher)
+{
+    pthread_mutex_lock(&watcher->lock);
+    bool running = watcher->running;
+    pthread_mutex_unlock(&watcher->lock);
+    return running;
+}
+
+static void watcher_push_update(FolderWatcher *watcher, TrackUpdate *update)
+{
+    pthread_mutex_lock(&watcher->lock);
+    if (watcher->last_update)
+        watcher->last_update->next = update;
+    else
+        watcher->first_update = update;
+    watcher->last_update = update;
+    pthread_mutex_unlock(&watcher->lock);
+}
+
+static void watcher_free_updates(TrackUpdate *update)
+{
+    while (update)
+    {
+        TrackUpdate *next = update->next;
+        gpxParser_free_parsed_tracks(update->tracks, update->total_tracks);
+        free(update);
+        update = next;
+    }
+}
+
+static void watcher_process_pending(FolderWatcher *watcher, char pending[][256], int pending_count)
+{
+    for (int i = 0; i < pending_count; i++)
+    {
+        TrackUpdate *update = (TrackUpdate *)calloc(1, sizeof(TrackUpdate));
+        if (!update)
+        {
+            perror("calloc");
+            continue;
+        }
+        strncpy(update->file_name, pending[i], sizeof(update->file_name) - 1);
+
+        // a file that is gone parses to no tracks, which removes its old ones
+        update->total_tracks = gpxParser_parse_folder_entry(watcher->folder_path, update->file_name, &update->tracks);
+        printf("Folder watcher: %s has %d tracks now\n", update->file_name, update->total_tracks);
+        watcher_push_update(watcher, update);
+    }
+}
+
+static void *watcher_thread(void *arg)
+{
+    FolderWatcher *watcher = (FolderWatcher *)arg;
+    trace_set_thread_name("folder watcher");
+
+    char pending[WATCHER_MAX_PENDING][256];
+    int pending_count = 0;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (watcher_is_running(watcher))
+    {
+        struct pollfd pfd = {.fd = watcher->inotify_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, WATCHER_SETTLE_MS);
+
+        if (ready > 0)
+        {
+            ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+            for (char *p = buffer; length > 0 && p < buffer + length;)
+            {
+                struct inotify_event *event = (struct inotify_event *)p;
+                p += sizeof(struct inotify_event) + event->len;
+
+                // hidden files are temporary files of sync tools and editors
+                if (event->len == 0 || event->name[0] == '.')
+                    continue;
+
+                bool known = false;
+                for (int i = 0; i < pending_count; i++)
+                {
+                    if (strcmp(pending[i], event->name) == 0)
+                    {
+                        known = true;
+                        break;
+                    }
+                }
+                if (known)
+                    continue;
+
+                if (pending_count == WATCHER_MAX_PENDING)
+                {
+                    watcher_process_pending(watcher, pending, pending_count);
+                    pending_count = 0;
+                }
+                strncpy(pending[pending_count], event->name, sizeof(pending[0]) - 1);
+                pending[pending_count][sizeof(pending[0]) - 1] = '\0';
+                pending_count++;
+            }
+            continue;
+        }
+
+        // folder is quiet, files are completely written
+        if (ready == 0 && pending_count > 0)
+        {
+            watcher_process_pending(watcher, pending, pending_count);
+            pending_count = 0;
+        }
+    }
+    return NULL;
+}
+
+bool watcher_start(FolderWatcher *watcher, const char *folder_path)
+{
+    watcher->folder_path = folder_path;
+    watcher->first_update = NULL;
+    watcher->last_update = NULL;
+    watcher->running = true;
+
+    watcher->inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (watcher->inotify_fd < 0)
+    {
+        perror("inotify_init1");
+        return false;
+    }
+    if (inotify_add_watch(watcher->inotify_fd, folder_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+    {
+        perror("inotify_add_watch");
+        close(watcher->inotify_fd);
+        watcher->inotify_fd = -1;
+        return false;
+    }
+
+    pthread_mutex_init(&watcher->lock, NULL);
+    if (pthread_create(&watcher->thread, NULL, watcher_thread, watcher) != 0)
+    {
+        fprintf(stderr, "Failed to create folder watcher thread\n");
+        close(watcher->inotify_fd);
+        watcher->inotify_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void watcher_stop(FolderWatcher *watcher)
+{
+    if (watcher->inotify_fd < 0)
+        return;
+
+    pthread_mutex_lock(&watcher->lock);
+    watcher->running = false;
+    pthread_mutex_unlock(&watcher->lock);
+    pthread_join(watcher->thread, NULL);
+
+    close(watcher->inotify_fd);
+    watcher->inotify_fd = -1;
+    watcher_free_updates(watcher->first_update);
+    watcher->first_update = NULL;
+    watcher->last_update = NULL;
+    pthread_mutex_destroy(&watcher->lock);
+}
+
+// Zip members are stored as "<archive>/<member>"
+static bool watcher_source_matches(const char *source_name, const char *file_name)
+{
+    size_t length = strlen(file_name);
+    return strncmp(source_name, file_name, length) == 0 && (source_name[length] == '\0' || source_name[length] == '/');
+}
+
+static void watcher_extend_bounds(const GpxTrack *track, int bounds[4])
+{
+    PointStream stream;
+    pointStream_init(&stream, track);
+    while (pointStream_next(&stream))
+    {
+        if (stream.world_x < bounds[0])
+            bounds[0] = stream.world_x;
+        if (stream.world_y < bounds[1])
+            bounds[1] = stream.world_y;
+        if (stream.world_x > bounds[2])
+            bounds[2] = stream.world_x;
+        if (stream.world_y > bounds[3])
+            bounds[3] = stream.world_y;
+    }
+}
+
+static int watcher_append_slot(GpxCollection *collection)
+{
+    GpxTrack *tracks = (GpxTrack *)realloc(collection->tracks, (collection->total_tracks + 1) * sizeof(GpxTrack));
+    if (!tracks)
+    {
+        perror("realloc");
+        return -1;
+    }
+    collection->tracks = tracks;
+
+    int *order = (int *)realloc(collection->list_order, (collection->total_tracks + 1) * sizeof(int));
+    if (!order)
+    {
+        perror("realloc");
+        return -1;
+    }
+    collection->list_order = order;
+
+    // new tracks go to the end of the list until it is sorted again
+    int slot = collection->total_tracks++;
+    collection->list_order[slot] = slot;
+    memset(&collection->tracks[slot], 0, sizeof(GpxTrack));
+    collection->tracks[slot].removed = true;
+    return slot;
+}
+
+static void watcher_merge_update(struct application *appl, GpxCollection *collection, TrackUpdate *update)
+{
+    int old_max_heat = collection->max_heat;
+    int bounds[4] = {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+
+    // take back the heat of all old tracks of the file, one after the other so they do not count each other
+    for (int i = 0; i < collection->total_tracks; i++)
+    {
+        GpxTrack *track = &collection->tracks[i];
+        if (track->removed || !watcher_source_matches(track->source_name, update->file_name))
+            continue;
+
+        watcher_extend_bounds(track, bounds);
+        update_heatmap_for_track(collection, i, -1);
+        track->removed = true;
+        track->visible_in_list = false;
+        pointArena_release(&collection->point_arena, track);
+        trackPyramid_release(&collection->pyramid, track);
+        if (appl->selected_track == i)
+            appl->selected_track = -1;
+    }
+
+    // a changed track keeps its slot and id, its old points are reclaimed by the next compaction
+    int slots[update->total_tracks + 1];
+    for (int n = 0; n < update->total_tracks; n++)
+    {
+        GpxTrack *parsed = &update->tracks[n];
+        int slot = -1;
+        for (int i = 0; i < collection->total_tracks; i++)
+        {
+            if (collection->tracks[i].removed && strcmp(collection->tracks[i].source_name, parsed->source_name) == 0)
+            {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0)
+            slot = watcher_append_slot(collection);
+        slots[n] = slot;
+        if (slot < 0)
+            continue;
+
+        GpxTrack *track = &collection->tracks[slot];
+        *track = *parsed;
+        track->track_id = slot;
+        track->points = NULL;
+        if (!pointArena_append(&collection->point_arena, parsed->points, parsed->total_points, track))
+        {
+            track->removed = true;
+            track->total_points = 0;
+            slots[n] = -1;
+        }
+    }
+    pointArena_bind_tracks(&collection->point_arena, collection->tracks, collection->total_tracks);
+
+    // add the heat of the new tracks one by one, each sees the ones before it
+    apply_filter_values(collection);
+    bool visible[update->total_tracks + 1];
+    for (int n = 0; n < update->total_tracks; n++)
+    {
+        if (slots[n] < 0)
+            continue;
+        GpxTrack *track = &collection->tracks[slots[n]];
+        trackPyramid_build(&collection->pyramid, track);
+        visible[n] = track->visible_in_list;
+        track->visible_in_list = false;
+    }
+    for (int n = 0; n < update->total_tracks; n++)
+    {
+        if (slots[n] < 0)
+            continue;
+        GpxTrack *track = &collection->tracks[slots[n]];
+        track->visible_in_list = visible[n];
+        watcher_extend_bounds(track, bounds);
+        update_heatmap_for_track(collection, slots[n], 1);
+    }
+
+    // colors are relative to the maximum heat, if that moved every tile has to be drawn again
+    if (collection->max_heat != old_max_heat)
+    {
+        free_track_tile_cache(&collection->track_tile_cache);
+    }
+    else if (bounds[0] <= bounds[2])
+    {
+        // heat changes at samples within the radius, the raw points between two samples take
+        // their heat from the samples up to heat_sample_spacing away
+        int spacing = heat_sample_spacing > 0 ? heat_sample_spacing : 0;
+        int margin_x = (int)(HEAT_RADIUS / HEAT_MIN_X_CORRECTION) + 1 + spacing;
+        int margin_y = (int)HEAT_RADIUS + 1 + spacing;
+        invalidate_track_tiles(&collection->track_tile_cache, bounds[0] - margin_x, bounds[1] - margin_y, bounds[2] + margin_x, bounds[3] + margin_y);
+    }
+}
+
+// Called once per frame from the main loop, returns true when the collection changed
+bool watcher_apply_updates(FolderWatcher *watcher, struct application *appl, GpxCollection *collection)
+{
+    if (watcher->inotify_fd < 0)
+        return false;
+
+    pthread_mutex_lock(&watcher->lock);
+    TrackUpdate *updates = watcher->first_update;
+    watcher->first_update = NULL;
+    watcher->last_update = NULL;
+    pthread_mutex_unlock(&watcher->lock);
+
+    if (!updates)
+        return false;
+
+    for (TrackUpdate *update = updates; update; update = update->next)
+        watcher_merge_update(appl, collection, update);
+
+    // every sync leaves the old ranges of changed and deleted tracks behind, in a long session
+    // they would pile up without this
+    pointArena_compact(&collection->point_arena, collection->tracks, collection->total_tracks);
+    trackPyramid_compact(&collection->pyramid, collection->tracks, collection->total_tracks);
+
+    watcher_free_updates(updates);
+    return true;
+}
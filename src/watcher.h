@@ -0,0 +1,27 @@
+#ifndef watcher_h
+#define watcher_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "structs.h"
+#include "gpxParser.h"
+#include "pointarena.h"
+#include "filters.h"
+#include "heat.h"
+#include "tracks.h"
+#include "trace.h"
+
+#define WATCHER_SETTLE_MS 500 // wait until the folder was quiet this long before parsing
+#define WATCHER_MAX_PENDING 256
+
+bool watcher_start(FolderWatcher *watcher, const char *folder_path);
+void watcher_stop(FolderWatcher *watcher);
+bool watcher_apply_updates(FolderWatcher *watcher, struct application *appl, GpxCollection *collection);
+
+#endif